@@ -3,6 +3,7 @@
 uniform sampler2D fftwave; // frequency data and sound wave
 uniform vec2 resolution; // viewport resolution
 uniform float time; // playback time
+uniform float bands[64]; // coarse frequency data
 
 // ##############################
 // BEGIN	IQ methods
@@ -152,11 +153,17 @@ vec3 getMaterialColor(vec3 point)
 	return vec3(0.45*sin(((c+time)/count)*2.*PI)+0.55);
 }
 
+#if QUALITY_TIER >= QUALITY_HIGH
+const int shadowSteps = 16;
+#else
+const int shadowSteps = 8;
+#endif
+
 float softshadow(const vec3 origin, in vec3 dir, in float mint, in float tmax, float k)
 {
 	float res = 1.0;
 	float t = mint;
-	for( int i=0; i<16; i++ )
+	for( int i=0; i<shadowSteps; i++ )
 	{
 		float h = distFunc( origin + dir*t );
 		res = min( res, k*h/t );
@@ -179,8 +186,10 @@ float ambientOcclusion(vec3 point, float delta, int samples)
 }
 
 
-//	Lighting settings
+//	Lighting settings, QUALITY_TIER is defined by the renderer
+#if QUALITY_TIER >= QUALITY_MEDIUM
 #define ENABLE_SHADOWS
+#endif
 //#define ENABLE_OCCLUSION
 
 const float lightAttenuation = 0.00;
@@ -247,7 +256,13 @@ vec3 getShadedColor( vec3 hitPosition, vec3 normal, vec3 cameraPosition )
 }
 
 const float epsilon = 0.0001;
+#if QUALITY_TIER <= QUALITY_LOW
+const int maxSteps = 96;
+#elif QUALITY_TIER == QUALITY_MEDIUM
+const int maxSteps = 160;
+#else
 const int maxSteps = 256;
+#endif
 const float maxT = 20.0;
 float trace(vec3 ro, vec3 rd, out vec3 point, out bool objectHit)
 {
@@ -281,14 +296,18 @@ float trace(vec3 ro, vec3 rd, out vec3 point, out bool objectHit)
 
 void populateSoundArray()
 {
-    // Get FFT values from texture
+    // Get FFT values from coarse bands
     for (int i = 0; i < afFrequencies.length(); i++)
     {
-        afFrequencies[i] = texture( fftwave, vec2(float(i)/float(afFrequencies.length()), 0.25) ).x;
+        afFrequencies[i] = bands[i * 8];
     }
 }
 
+#if QUALITY_TIER >= QUALITY_HIGH
 const int reflectionBounces = 2;
+#else
+const int reflectionBounces = 1;
+#endif
 void main()
 {
     // Fill arrays for sound things
@@ -4,17 +4,26 @@ uniform sampler2D fftwave; // frequency data and sound wave
 uniform vec2 resolution; // viewport resolution
 uniform int sample_size; // frequency data width
 uniform float time; // playback time
+uniform float bands[64]; // coarse frequency data
 
 #define MUSICCHANNEL fftwave
 #define MUSICTEXWIDTH sample_size
 #define CONTACT 0.04
 
-const int iDiskCount = 48; // switch to 64 for performance
+// QUALITY_TIER is defined by the renderer, lower tiers trade detail for speed
+#if QUALITY_TIER <= QUALITY_LOW
+const int iDiskCount = 24;
+const int iMaxSamples = 32;
+#elif QUALITY_TIER == QUALITY_MEDIUM
+const int iDiskCount = 48;
+const int iMaxSamples = 48;
+#else
+const int iDiskCount = 64;
+const int iMaxSamples = 64;
+#endif
 const float fInnerDisk = 0.002;
 const float fMinSamplingRate = 1.0 / 1024.;
 
-const int iMaxSamples = 64;
-
 const float fSplitY = 1.0 / float(iDiskCount);
 const float TexelsPerDisk = 1.0 / float(iDiskCount + 1);
 
@@ -55,7 +64,7 @@ vec4 map(vec3 pos) {
     vec4 Result = vec4(1e9, 0.0, 0.0, 0.0);
 
     for(int i = 0; i < iDiskCount; ++i) {
-        float DiskWidth = textureGrad(MUSICCHANNEL, vec2(1.0 - float(i) * TexelsPerDisk, 0.0), vec2(0.0), vec2(0.0)).r;
+        float DiskWidth = bands[int((1.0 - float(i) * TexelsPerDisk) * 63.0)];
         float AvoidDisk = (step(DiskWidth, 1e-5)) * 1e9;
         
         float DiskY = float(i) * (1.0 / float(iDiskCount)) - 0.5;
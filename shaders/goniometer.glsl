@@ -0,0 +1,32 @@
+#version 130
+
+uniform sampler2D fftwave; // frequency data and sound wave
+uniform vec2 resolution; // viewport resolution
+uniform int sample_size; // frequency data width
+
+// STEREO_SPECTRUM: reads the left, right and side spectra
+
+void main()
+{
+    // centered square coordinates
+    vec2 uv = (gl_FragCoord.xy - 0.5 * resolution.xy) / min(resolution.x, resolution.y);
+
+    // stereo spectrum in the background, left channel bottom half, right top half
+    int tx = int((gl_FragCoord.x / resolution.x) * sample_size);
+    vec4 fft = texelFetch( fftwave, ivec2(tx,0), 0 );
+    float level = gl_FragCoord.y < 0.5 * resolution.y ? fft.g : fft.b;
+    vec3 col = vec3( 0.1, 0.2, 0.4 ) * level + vec3( 0.3, 0.1, 0.2 ) * fft.a;
+
+    // second row holds left and right goniometer points,
+    // rotate them by 45 degrees so mono is vertical
+    float d = 1e9;
+    for (int i = 0; i < sample_size; i++) {
+        vec2 lr = texelFetch( fftwave, ivec2(i,1), 0 ).gb * 2.0 - 1.0;
+        vec2 p = 0.35 * vec2( lr.y - lr.x, lr.x + lr.y );
+        d = min( d, length( uv - p ) );
+    }
+
+    col += vec3( 0.4, 1.0, 0.6 ) * (1.0 - smoothstep( 0.0, 0.006, d ));
+
+    gl_FragColor = vec4(col,1.0);
+}
@@ -0,0 +1,23 @@
+#version 130
+
+uniform sampler2D trail; // input to blur
+uniform vec2 resolution; // pass resolution
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / resolution.xy;
+    vec2 texel = 1.0 / resolution.xy;
+
+    // 5x5 binomial blur, the input is sampled between texels
+    const float weights[5] = float[5]( 1.0, 4.0, 6.0, 4.0, 1.0 );
+
+    vec3 sum = vec3( 0.0 );
+    for (int y = 0; y < 5; y++) {
+        for (int x = 0; x < 5; x++) {
+            vec2 offset = vec2( float(x - 2), float(y - 2) ) * texel;
+            sum += texture( trail, uv + offset ).rgb * weights[x] * weights[y];
+        }
+    }
+
+    gl_FragColor = vec4(sum / 256.0,1.0);
+}
@@ -0,0 +1,24 @@
+#version 130
+
+uniform sampler2D fftwave; // frequency data and sound wave
+uniform sampler2D trail; // this pass on the previous frame
+uniform vec2 resolution; // pass resolution
+uniform int sample_size; // frequency data width
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / resolution.xy;
+
+    // previous frame drifts up a pixel and fades out
+    vec3 previous = texture( trail, uv - vec2( 0.0, 1.0 / resolution.y ) ).rgb * 0.96;
+
+    int tx = int(uv.x*sample_size);
+    float fft  = texelFetch( fftwave, ivec2(tx,0), 0 ).x;
+    float wave = texelFetch( fftwave, ivec2(tx,1), 0 ).x;
+
+    // current wave coloured by the spectrum
+    float line = 1.0 - smoothstep( 0.0, 0.02, abs(wave - uv.y) );
+    vec3 col = vec3( 0.2 + fft, 0.6 * fft, 1.0 - fft ) * line;
+
+    gl_FragColor = vec4(max(previous, col),1.0);
+}
@@ -4,6 +4,9 @@ uniform sampler2D fftwave; // frequency data and sound wave
 uniform vec2 resolution; // viewport resolution
 uniform int sample_size; // frequency data width
 uniform float time; // playback time
+uniform float beat_phase; // 0 - 1, 0 is on the beat
+uniform float onset; // onset strength
+uniform float bands[64]; // coarse frequency data
 
 // #define ONE_SABER
 
@@ -13,10 +16,10 @@ void main()
     uv = -1.0 + 2.0 * uv;
     uv.x *= resolution.x / resolution.y;
     float freqs[4];
-    freqs[0] = texture( fftwave, vec2( 0.01, 0.25 ) ).x;
-    freqs[1] = texture( fftwave, vec2( 0.07, 0.25 ) ).x;
-    freqs[2] = texture( fftwave, vec2( 0.15, 0.25 ) ).x;
-    freqs[3] = texture( fftwave, vec2( 0.30, 0.25 ) ).x;
+    freqs[0] = bands[0];
+    freqs[1] = bands[4];
+    freqs[2] = bands[9];
+    freqs[3] = bands[19];
     
     uv.x += sin(uv.y * uv.y + time * 1.5) * freqs[3];
     
@@ -31,6 +34,9 @@ void main()
     }
     #endif
     
+    // flash on onsets, fade over the beat
+    d *= 1.0 + 0.5 * min(onset, 2.0) * (1.0 - beat_phase);
+
     vec3 colour = vec3(freqs[0], freqs[1], freqs[2] * 2.0) * d;
     if (length(vec4(freqs[0], freqs[1], freqs[2], freqs[3])) > 1.5) {
         colour = 1.0 - colour;
@@ -0,0 +1,15 @@
+#version 130
+
+uniform sampler2D trail; // waveform trails, half resolution
+uniform sampler2D glow; // blurred trails, quarter resolution
+uniform vec2 resolution; // viewport resolution
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / resolution.xy;
+
+    // trails with a soft glow around them
+    vec3 col = texture( trail, uv ).rgb + 1.5 * texture( glow, uv ).rgb;
+
+    gl_FragColor = vec4(col,1.0);
+}
@@ -0,0 +1,25 @@
+#version 130
+
+uniform sampler2D history; // ring of past spectrum frames
+uniform vec2 resolution; // viewport resolution
+uniform int history_head; // row of the newest frame
+uniform int history_size; // rows in the ring
+
+// STEREO_SPECTRUM: reads the left and right spectra
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / resolution.xy;
+
+    // newest frame at the top, older ones scroll down
+    float age = (1.0 - uv.y) * float(history_size - 1);
+    float row = (float(history_head) - age + 0.5) / float(history_size);
+
+    // wraps around the ring
+    vec4 fft = texture( history, vec2( uv.x, row ) );
+
+    // left channel in red, right in blue, mono in green
+    vec3 col = vec3( fft.g, fft.r * 0.6, fft.b ) * fft.r;
+
+    gl_FragColor = vec4(col,1.0);
+}
@@ -2,6 +2,7 @@ import QtQuick 2.11
 import QtQuick.Controls 2.2
 import QtQuick.Layouts 1.3
 import QtQuick.Controls.Material 2.2
+import QtQuick.Window 2.11
 
 ToolBar {
     id: buttonToolbar
@@ -16,6 +17,7 @@ ToolBar {
     property alias mediaVolume: volumeSlider.value
     property alias mediaMuted: muteButton.checked
     property alias mediaCoverUrl: albumCover.albumArt
+    property alias mediaWaveformUrl: waveformImage.source
 
     property int newMediaPosition: 0
     property int lastMediaPosition: 0
@@ -66,6 +68,10 @@ ToolBar {
                 anchors.centerIn: parent
                 anchors.fill: parent
                 mipmap: true
+                asynchronous: true
+                // picks a cover thumbnail, and keeps the icon sharp
+                sourceSize.width: width * Screen.devicePixelRatio
+                sourceSize.height: height * Screen.devicePixelRatio
 
                 fillMode: Image.PreserveAspectFit
 
@@ -127,6 +133,19 @@ ToolBar {
                     ]
 
                     background: Item {
+                        // waveform overview of the whole track
+                        Image {
+                            id: waveformImage
+                            x: progressBar.leftPadding
+                            y: progressBar.topPadding
+                            width: progressBar.availableWidth
+                            height: progressBar.availableHeight
+                            sourceSize.width: width
+                            sourceSize.height: height
+                            asynchronous: true
+                            cache: false
+                        }
+
                         Rectangle {
                             id: progressBarBackground
                             x: progressBar.leftPadding
@@ -1,6 +1,12 @@
 #include "applicationcontroller.h"
 
 #include <QDebug>
+#include <QFileInfo>
+
+#include <algorithm>
+
+// directories found within this are added as one scan
+constexpr int found_files_interval = 250;
 
 PlaylistItemModel* ApplicationController::playlistModel()
 {
@@ -40,42 +46,57 @@ int ApplicationController::position() const
 
 int ApplicationController::duration() const
 {
-    qDebug() << "duration() ->" << m_playlistModel->currentFileInfo().duration;// m_soundEngine->duration();
-    return m_playlistModel->currentFileInfo().duration;//m_soundEngine->duration();
+    const int current = currentItem();
+    const auto value = current >= 0 ? m_playlistModel->items().duration(current) : 0;
+
+    qDebug() << "duration() ->" << value;
+    return value;
 }
 
 QString ApplicationController::artist() const
 {
-    qDebug() << "artist() ->" << m_playlistModel->currentFileInfo().artist;
-    return m_playlistModel->currentFileInfo().artist;
+    const int current = currentItem();
+    const auto value = current >= 0 ? m_playlistModel->items().artist(current) : QString();
+
+    qDebug() << "artist() ->" << value;
+    return value;
 }
 
 QString ApplicationController::song() const
 {
-    qDebug() << "song() ->" << m_playlistModel->currentFileInfo().song;
-    return m_playlistModel->currentFileInfo().song;
+    const int current = currentItem();
+    const auto value = current >= 0 ? m_playlistModel->items().song(current) : QString();
+
+    qDebug() << "song() ->" << value;
+    return value;
 }
 
 QString ApplicationController::album() const
 {
-    qDebug() << "album() ->" << m_playlistModel->currentFileInfo().album;
-    return m_playlistModel->currentFileInfo().album;
+    const int current = currentItem();
+    const auto value = current >= 0 ? m_playlistModel->items().album(current) : QString();
+
+    qDebug() << "album() ->" << value;
+    return value;
 }
 
 QString ApplicationController::coverUrl() const
 {
-    qDebug() << "coverUrl() ->" << m_playlistModel->currentFileInfo().coverUrl;
-    return m_playlistModel->currentFileInfo().coverUrl;
+    const int current = currentItem();
+    const auto value = current >= 0 ? m_playlistModel->items().coverUrl(current) : QString();
+
+    qDebug() << "coverUrl() ->" << value;
+    return value;
 }
 
-std::shared_ptr<RingBufferT<double>> ApplicationController::spectrumBuffer()
+QString ApplicationController::waveformUrl() const
 {
-    return m_soundEngine->getSpectrumDataBuffer();
+    return QString("image://waveform/%1").arg(m_waveformRevision);
 }
 
-std::shared_ptr<RingBufferT<double>> ApplicationController::waveformBuffer()
+std::shared_ptr<audioengine::AnalysisFrameBuffer> ApplicationController::frameBuffer()
 {
-    return m_soundEngine->getWaveformDataBuffer();
+    return m_soundEngine->getAnalysisFrameBuffer();
 }
 
 void ApplicationController::play(bool isSetPlay)
@@ -154,9 +175,78 @@ void ApplicationController::addFiles(const QList<QUrl> &filePathList)
     }
 }
 
+void ApplicationController::addFolder(const QUrl &folder)
+{
+    qDebug() << "addFolder()" << folder;
+    m_directoryWalker->walk(folder.toLocalFile());
+}
+
+void ApplicationController::addFoundFiles(quint64 generation, const QStringList &paths)
+{
+    // queued before the playlist was cleared
+    if(generation != m_directoryWalker->generation()) {
+        return;
+    }
+
+    // a walk reports a batch per directory, they are added together
+    m_foundFiles << paths;
+    if(!m_foundFilesTimer.isActive()) {
+        m_foundFilesTimer.start();
+    }
+}
+
+void ApplicationController::flushFoundFiles()
+{
+    if(m_foundFiles.isEmpty()) {
+        return;
+    }
+
+    bool wasEmpty = !m_playlistModel->size();
+
+    m_playlistModel->addFilePaths(m_foundFiles);
+    m_foundFiles.clear();
+
+    // the first tracks play while the rest of the folder is walked
+    if(wasEmpty) {
+        setCurrentItem(0);
+    }
+}
+
+void ApplicationController::loadPlaylist(const QUrl &playlist)
+{
+    qDebug() << "loadPlaylist()" << playlist;
+
+    bool wasEmpty = !m_playlistModel->size();
+
+    if(!m_playlistModel->importPlaylist(playlist.toLocalFile())) {
+        emit error(QString("Playlist failed to open:\n%1").arg(playlist.toLocalFile()));
+    }
+
+    if(wasEmpty && m_playlistModel->size()) {
+        setCurrentItem(0);
+    }
+}
+
+void ApplicationController::savePlaylist(const QUrl &playlist)
+{
+    qDebug() << "savePlaylist()" << playlist;
+
+    QString fileName = playlist.toLocalFile();
+    if(QFileInfo(fileName).suffix().isEmpty()) {
+        fileName += ".m3u8";
+    }
+
+    if(!m_playlistModel->exportPlaylist(fileName)) {
+        emit error(QString("Playlist failed to save:\n%1").arg(fileName));
+    }
+}
+
 void ApplicationController::removeAllFiles()
 {
     qDebug() << "removeAllFiles()";
+    m_directoryWalker->cancel();
+    m_foundFilesTimer.stop();
+    m_foundFiles.clear();
     m_playlistModel->reset();
     m_soundEngine->clearCache();
     emit metadataChanged();
@@ -174,6 +264,28 @@ void ApplicationController::setCurrentItem(int index)
     }
 }
 
+void ApplicationController::sortPlaylist(int key, bool descending)
+{
+    qDebug() << "sortPlaylist():" << key << descending;
+
+    // the current file keeps playing, its neighbours change
+    const QStringList wasCached = precacheWindow();
+
+    m_playlistModel->sortBy(static_cast<PlaylistSorter::SortKey>(key),
+                            descending ? Qt::DescendingOrder : Qt::AscendingOrder);
+
+    const QStringList toBeCached = precacheWindow();
+
+    for(const QString& path : toBeCached) {
+        m_soundEngine->preloadFile(path);
+    }
+    for(const QString& path : wasCached) {
+        if(!toBeCached.contains(path)) {
+            m_soundEngine->removeFileFromCache(path);
+        }
+    }
+}
+
 void ApplicationController::removeItem(int index)
 {
     qDebug() << "removeItem():" << index;
@@ -210,7 +322,7 @@ bool ApplicationController::loadFileForPlayback(const QString &filename)
 
 bool ApplicationController::loadFileInPlaylist(int index)
 {
-    return loadFileForPlayback(m_playlistModel->getFileInfo(index).path);
+    return loadFileForPlayback(m_playlistModel->filePath(index));
 }
 
 void ApplicationController::playNextFile()
@@ -227,6 +339,31 @@ void ApplicationController::playNextFile()
     }
 }
 
+int ApplicationController::currentItem() const
+{
+    const int current = m_playlistModel->currentIndex();
+
+    return m_playlistModel->isValidIndex(current) ? m_playlistModel->itemIndex(current) : -1;
+}
+
+QStringList ApplicationController::precacheWindow() const
+{
+    QStringList paths;
+
+    const int current = m_playlistModel->currentIndex();
+    if(!m_playlistModel->isValidIndex(current)) {
+        return paths;
+    }
+
+    const int first = std::max(current - precache_size, 0);
+    const int last = std::min(current + precache_size, m_playlistModel->size() - 1);
+    for(int i = first; i <= last; ++i) {
+        paths << m_playlistModel->filePath(i);
+    }
+
+    return paths;
+}
+
 void ApplicationController::updateCacheNearIndex(int oldIndex)
 {
     int currentIndex = m_playlistModel->currentIndex();
@@ -247,7 +384,7 @@ void ApplicationController::updateCacheNearIndex(int oldIndex)
 
     // precache
     for(int i = toBeCachedLeftIndex; i <= toBeCachedRightIndex; ++i) {
-        m_soundEngine->preloadFile(m_playlistModel->getFileInfo(i).path);
+        m_soundEngine->preloadFile(m_playlistModel->filePath(i));
     }
 
     // uncache others
@@ -270,25 +407,34 @@ void ApplicationController::updateCacheNearIndex(int oldIndex)
         // check if it overlaps
         if(wasCachedLeft >= toBeCachedRightIndex || wasCachedRight <= toBeCachedLeftIndex) {
             for(int i = wasCachedLeft; i <= wasCachedRight; ++i) {
-                m_soundEngine->removeFileFromCache(m_playlistModel->getFileInfo(i).path);
+                m_soundEngine->removeFileFromCache(m_playlistModel->filePath(i));
             }
         } else {
             // left side
             for(int i = wasCachedLeft; i < toBeCachedLeftIndex; ++i) {
-                m_soundEngine->removeFileFromCache(m_playlistModel->getFileInfo(i).path);
+                m_soundEngine->removeFileFromCache(m_playlistModel->filePath(i));
             }
             // right side
             for(int i = toBeCachedRightIndex + 1; i <= wasCachedRight; ++i) {
-                m_soundEngine->removeFileFromCache(m_playlistModel->getFileInfo(i).path);
+                m_soundEngine->removeFileFromCache(m_playlistModel->filePath(i));
             }
         }
     }
 }
 
+void ApplicationController::updateWaveform()
+{
+    ++m_waveformRevision;
+    emit waveformChanged();
+}
+
 ApplicationController::ApplicationController(QObject *parent)
     : QObject(parent),
       m_playlistModel(new PlaylistItemModel()),
-      m_soundEngine(new PlaybackEngine())
+      m_playlistSearch(new PlaylistSearchModel(m_playlistModel)),
+      m_soundEngine(new PlaybackEngine()),
+      m_directoryWalker(new DirectoryWalker()),
+      m_waveformRevision(0)
 {
     // interconnect
     QObject::connect(m_soundEngine, &PlaybackEngine::spectrumDataChanged,
@@ -306,15 +452,40 @@ ApplicationController::ApplicationController(QObject *parent)
                      this, &ApplicationController::loadFileInPlaylist,
                      Qt::QueuedConnection);
 
+    // tags of the current file can arrive after it started playing
+    QObject::connect(m_playlistModel, &PlaylistItemModel::dataChanged,
+                     this, [this](const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+        const int current = m_playlistModel->currentIndex();
+        if(current >= topLeft.row() && current <= bottomRight.row()) {
+            emit metadataChanged();
+        }
+    });
+
     QObject::connect(m_soundEngine, &PlaybackEngine::playbackStatusChanged,
                      this, &ApplicationController::playbackStatusChanged);
 
     QObject::connect(m_soundEngine, &PlaybackEngine::fileEnded,
                      this, &ApplicationController::playNextFile);
+
+    QObject::connect(m_soundEngine, &PlaybackEngine::waveformOverviewChanged,
+                     this, &ApplicationController::updateWaveform,
+                     Qt::QueuedConnection);
+
+    QObject::connect(m_directoryWalker, &DirectoryWalker::filesFound,
+                     this, &ApplicationController::addFoundFiles,
+                     Qt::QueuedConnection);
+
+    // rows still show up while the walk goes on
+    m_foundFilesTimer.setSingleShot(true);
+    m_foundFilesTimer.setInterval(found_files_interval);
+    QObject::connect(&m_foundFilesTimer, &QTimer::timeout,
+                     this, &ApplicationController::flushFoundFiles);
 }
 
 ApplicationController::~ApplicationController()
 {
+    delete m_directoryWalker;
     delete m_soundEngine;
+    delete m_playlistSearch;
     delete m_playlistModel;
 }
@@ -2,10 +2,14 @@
 #define APPLICATIONCONTROLLER_H
 
 #include "audiotaginfo.h"
+#include "directorywalker.h"
 #include "playlistitemmodel.h"
+#include "playlistsearchmodel.h"
 #include "playbackengine.h"
 
 #include <QObject>
+#include <QStringList>
+#include <QTimer>
 
 class ApplicationController : public QObject
 {
@@ -22,22 +26,37 @@ class ApplicationController : public QObject
     Q_PROPERTY(QString song READ song NOTIFY metadataChanged)
     Q_PROPERTY(QString album READ album NOTIFY metadataChanged)
     Q_PROPERTY(QString coverUrl READ coverUrl NOTIFY metadataChanged)
+    Q_PROPERTY(QString waveformUrl READ waveformUrl NOTIFY waveformChanged)
 
-    Q_PROPERTY(std::shared_ptr<RingBufferT<double>> spectrumBuffer READ spectrumBuffer NOTIFY spectrumChanged)
-    Q_PROPERTY(std::shared_ptr<RingBufferT<double>> waveformBuffer READ waveformBuffer NOTIFY spectrumChanged)
+    Q_PROPERTY(std::shared_ptr<audioengine::AnalysisFrameBuffer> frameBuffer READ frameBuffer NOTIFY spectrumChanged)
 
     Q_PROPERTY(PlaylistItemModel* playlist MEMBER m_playlistModel NOTIFY modelChanged)
+    Q_PROPERTY(PlaylistSearchModel* playlistSearch MEMBER m_playlistSearch NOTIFY modelChanged)
 
     PlaylistItemModel* m_playlistModel;
+    PlaylistSearchModel* m_playlistSearch;
     PlaybackEngine* m_soundEngine;
+    DirectoryWalker* m_directoryWalker;
+
+    // files of walked directories, added as one scan at a time
+    QStringList m_foundFiles;
+    QTimer m_foundFilesTimer;
 
     AudioTagInfo m_currentFileInfo;
 
+    // bumped to make QML request a new waveform image
+    int m_waveformRevision;
+
     //void writeSettings();
     //void readSettings();
 
     static constexpr int precache_size = 2;
 
+    // entry of the current file in the playlist store, -1 if there is none
+    int currentItem() const;
+    // files kept decoded around the current one
+    QStringList precacheWindow() const;
+
 public:
     explicit ApplicationController(QObject *parent = nullptr);
     ~ApplicationController();
@@ -56,9 +75,9 @@ public:
     QString song() const;
     QString album() const;
     QString coverUrl() const;
+    QString waveformUrl() const;
 
-    std::shared_ptr<RingBufferT<double>> spectrumBuffer();
-    std::shared_ptr<RingBufferT<double>> waveformBuffer();
+    std::shared_ptr<audioengine::AnalysisFrameBuffer> frameBuffer();
 
 signals:
     void playbackStatusChanged(bool isSetPlay);
@@ -67,6 +86,7 @@ signals:
     void durationChanged();
 
     void metadataChanged();
+    void waveformChanged();
 
     void spectrumChanged();
 
@@ -88,10 +108,18 @@ public slots:
 
     // playlist controls
     void addFiles(const QList<QUrl> &filePathList);
+    //! Adds the audio files under a folder while it is being walked.
+    void addFolder(const QUrl &folder);
     void removeAllFiles();
 
+    //! M3U, PLS and XSPF playlists, by suffix.
+    void loadPlaylist(const QUrl &playlist);
+    void savePlaylist(const QUrl &playlist);
+
     void setCurrentItem(int index);
     void removeItem(int index);
+    // key is a PlaylistSorter::SortKey
+    void sortPlaylist(int key, bool descending);
 
 private slots:
     bool loadFileForPlayback(const QString& filename);
@@ -99,7 +127,12 @@ private slots:
 
     void playNextFile();
 
+    void addFoundFiles(quint64 generation, const QStringList &paths);
+    void flushFoundFiles();
+
     void updateCacheNearIndex(int oldIndex);
+
+    void updateWaveform();
 };
 
 #endif // APPLICATIONCONTROLLER_H
@@ -0,0 +1,263 @@
+#pragma once
+
+#include "types.h"
+#include "spectrogram.h"
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+namespace audioengine {
+
+// tempo search range
+constexpr static double min_bpm = 60;
+constexpr static double max_bpm = 180;
+// tempos near this are preferred when the envelope is ambiguous
+constexpr static double preferred_bpm = 120;
+
+// sum of positive magnitude differences between two spectra
+template <typename T>
+T spectral_flux(const std::vector<T>& current, const std::vector<T>& previous) {
+    T flux = 0;
+    const size_t size = std::min(current.size(), previous.size());
+
+    for(size_t i = 0; i < size; ++i) {
+        flux += std::max(T(0), current[i] - previous[i]);
+    }
+
+    return size ? flux / size : 0;
+}
+
+/*
+ * Estimate a tempo by autocorrelation of an onset envelope.
+ * Returns 0 if the envelope is too short.
+ */
+inline float estimate_bpm(const std::vector<float>& envelope, double frame_rate) {
+    const int size = static_cast<int>(envelope.size());
+    const int min_lag = std::max(1, static_cast<int>(std::floor(frame_rate * 60. / max_bpm)));
+    const int max_lag = std::min(size / 2, static_cast<int>(std::ceil(frame_rate * 60. / min_bpm)));
+
+    if(frame_rate <= 0 || max_lag <= min_lag) {
+        return 0;
+    }
+
+    const float mean = std::accumulate(envelope.begin(), envelope.end(), 0.f) / size;
+
+    std::vector<double> correlation(max_lag + 2, 0.);
+    for(int lag = min_lag - 1; lag <= max_lag + 1; ++lag) {
+        if(lag <= 0 || lag >= size) {
+            continue;
+        }
+
+        double sum = 0;
+        for(int i = lag; i < size; ++i) {
+            sum += (envelope[i] - mean) * (envelope[i - lag] - mean);
+        }
+
+        correlation[lag] = sum / (size - lag);
+    }
+
+    int best_lag = 0;
+    double best_score = 0;
+    for(int lag = min_lag; lag <= max_lag; ++lag) {
+        // log-gaussian weight around the preferred tempo
+        const double octaves = std::log2(60. * frame_rate / lag / preferred_bpm);
+        const double score = correlation[lag] * std::exp(-0.5 * octaves * octaves);
+
+        if(score > best_score) {
+            best_score = score;
+            best_lag = lag;
+        }
+    }
+
+    if(!best_lag) {
+        return 0;
+    }
+
+    // parabolic interpolation for a fractional lag
+    double lag = best_lag;
+    const double left = correlation[best_lag - 1], center = correlation[best_lag], right = correlation[best_lag + 1];
+    const double denominator = left - 2 * center + right;
+    if(denominator < 0) {
+        lag += std::max(-0.5, std::min(0.5, 0.5 * (left - right) / denominator));
+    }
+
+    return static_cast<float>(60. * frame_rate / lag);
+}
+
+// tempo of a whole track from its spectrogram
+inline float estimate_track_bpm(const Spectrogram& spectrogram) {
+    if(spectrogram.frames() < 2) {
+        return 0;
+    }
+
+    std::vector<float> envelope(spectrogram.frames(), 0.f);
+    std::vector<float> row, previous;
+
+    spectrogram.read_row_db(0, previous);
+    for(int frame = 1; frame < spectrogram.frames(); ++frame) {
+        spectrogram.read_row_db(frame, row);
+        envelope[frame] = spectral_flux(row, previous);
+        std::swap(row, previous);
+    }
+
+    return estimate_bpm(envelope, spectrogram.frame_rate());
+}
+
+/*
+ * Per-track tempo, filled in on the decode pool.
+ */
+class TempoEstimate
+{
+    std::atomic<float> _bpm;
+
+public:
+    TempoEstimate() : _bpm(0) {}
+
+    bool ready() const { return _bpm > 0; }
+    float bpm() const { return _bpm; }
+    void set_bpm(float bpm) { _bpm = bpm; }
+};
+
+/*
+ * OnsetDetector turns spectral flux into an onset strength
+ * against an adaptive threshold.
+ */
+class OnsetDetector
+{
+    std::vector<float> _previous;
+    float _mean;
+    float _deviation;
+    bool _onset;
+
+    constexpr static float adaptation = 0.05f;
+    constexpr static float threshold_deviations = 1.5f;
+
+public:
+    OnsetDetector() : _mean(0), _deviation(0), _onset(false) {}
+
+    // returns onset strength, about 1 for a typical onset
+    template <typename T>
+    float process(const std::vector<T>& spectrum) {
+        if(_previous.size() != spectrum.size()) {
+            _previous.assign(spectrum.begin(), spectrum.end());
+            return 0;
+        }
+
+        float flux = 0;
+        for(size_t i = 0; i < spectrum.size(); ++i) {
+            flux += std::max(0.f, static_cast<float>(spectrum[i]) - _previous[i]);
+            _previous[i] = static_cast<float>(spectrum[i]);
+        }
+        flux /= spectrum.size();
+
+        const float threshold = _mean + threshold_deviations * _deviation;
+        const float strength = std::max(0.f, flux - _mean) / (threshold - _mean + 1e-6f);
+
+        _onset = flux > threshold;
+
+        _mean += adaptation * (flux - _mean);
+        _deviation += adaptation * (std::abs(flux - _mean) - _deviation);
+
+        return std::min(strength, 4.f);
+    }
+
+    bool onset() const { return _onset; }
+
+    void reset() {
+        _previous.clear();
+        _mean = _deviation = 0;
+        _onset = false;
+    }
+};
+
+/*
+ * BeatTracker keeps a beat phase running at the tempo and pulls it
+ * towards onsets. Without a known tempo it estimates one from recent onsets.
+ */
+class BeatTracker
+{
+    std::vector<float> _envelope;
+    int _envelope_pos;
+    int _frames_since_estimate;
+    double _frame_rate;
+    float _live_bpm;
+    float _phase;
+
+    constexpr static int envelope_size = 512;
+    constexpr static int estimate_interval = 64;
+    constexpr static float phase_correction = 0.1f;
+    constexpr static float phase_window = 0.2f;
+
+    std::vector<float> ordered_envelope() const {
+        std::vector<float> result(envelope_size);
+        for(int i = 0; i < envelope_size; ++i) {
+            result[i] = _envelope[(_envelope_pos + i) % envelope_size];
+        }
+        return result;
+    }
+
+public:
+    BeatTracker() :
+        _envelope(envelope_size, 0.f),
+        _envelope_pos(0),
+        _frames_since_estimate(0),
+        _frame_rate(0),
+        _live_bpm(0),
+        _phase(0)
+    {
+    }
+
+    /*
+     * Advance by dt seconds. Known tempo is used when positive.
+     * Returns the beat phase in 0 - 1, where 0 is on the beat.
+     */
+    float process(float onset_strength, bool onset, double dt, float known_bpm) {
+        if(dt <= 0) {
+            return _phase;
+        }
+
+        _frame_rate = _frame_rate > 0 ? 0.95 * _frame_rate + 0.05 / dt : 1. / dt;
+
+        _envelope[_envelope_pos] = onset_strength;
+        _envelope_pos = (_envelope_pos + 1) % envelope_size;
+
+        if(++_frames_since_estimate >= estimate_interval) {
+            _frames_since_estimate = 0;
+            _live_bpm = estimate_bpm(ordered_envelope(), _frame_rate);
+        }
+
+        const float bpm_value = bpm(known_bpm);
+        if(bpm_value <= 0) {
+            return _phase;
+        }
+
+        _phase += static_cast<float>(dt * bpm_value / 60.);
+        _phase -= std::floor(_phase);
+
+        // pull the phase towards onsets near the beat
+        if(onset) {
+            const float error = _phase > 0.5f ? _phase - 1.f : _phase;
+            if(std::abs(error) < phase_window) {
+                _phase -= phase_correction * error;
+                _phase -= std::floor(_phase);
+            }
+        }
+
+        return _phase;
+    }
+
+    float bpm(float known_bpm) const { return known_bpm > 0 ? known_bpm : _live_bpm; }
+    float phase() const { return _phase; }
+
+    void reset() {
+        std::fill(_envelope.begin(), _envelope.end(), 0.f);
+        _frames_since_estimate = 0;
+        _live_bpm = 0;
+        _phase = 0;
+    }
+};
+
+} // audioengine
@@ -1,10 +1,16 @@
 #pragma once
 
 #include "types.h"
+#include "spectrogram.h"
+#include "peakpyramid.h"
+#include "beattracker.h"
 #include "libnyquist/Decoders.h"
 
 #include <thread>
 #include <future>
+#include <fstream>
+#include <filesystem>
+#include <cstdio>
 #include <unordered_map>
 #include <functional>
 
@@ -47,18 +53,29 @@ struct DecodedFile {
     bool loaded;
     std::string filename;
     std::shared_ptr<nqr::AudioData> data;
+    std::shared_ptr<Spectrogram> spectrogram;
+    std::shared_ptr<PeakPyramid> peaks;
+    std::shared_ptr<TempoEstimate> tempo;
 };
 
 class Decoder {
     std::shared_ptr<RingBuffer> _sample_buffer, _viz_buffer;
     ctpl::thread_pool _pool;
     DecodedFile _current_file;
+    std::shared_ptr<Spectrogram> _current_spectrogram;
+    std::shared_ptr<PeakPyramid> _current_peaks;
+    std::shared_ptr<TempoEstimate> _current_tempo;
 
     std::thread _decoder_thread;
     std::atomic<bool> _running;
     std::atomic<bool> _pause;
     std::atomic<float> _volume;
     std::atomic<int> _current_frame;
+    std::atomic<int> _samples_per_second;
+    std::atomic<std::chrono::steady_clock::rep> _last_write_time;
+    // playhead for other threads, in interleaved samples, see snapshot_position()
+    std::atomic<int64_t> _written_samples;
+    std::atomic<int64_t> _audible_samples;
 
     int _buffer_size;
     int _track_frame_length;
@@ -69,6 +86,11 @@ class Decoder {
 
     DecoderCallbackFn _position_callback;
     DecoderCallbackFn _file_ended_callback;
+    DecoderCallbackFn _peaks_ready_callback;
+    DecoderCallbackFn _visualizer_callback;
+
+    // empty means no disk cache for track analysis
+    std::string _analysis_cache_dir;
 
     // full path is the key
     // NOTE: this is simpler to implement, but slower than an integer key
@@ -96,6 +118,11 @@ protected:
             _file_ended_callback();
     }
 
+    void notify_peaks_ready() {
+        if(_peaks_ready_callback)
+            _peaks_ready_callback();
+    }
+
     int write_to_buffer(const std::vector<float>& buffer) {
         assert(buffer.size() % _buffer_size == 0);
 
@@ -111,6 +138,9 @@ protected:
                 _viz_buffer->write(&buffer[frames_written * _buffer_size],
                                    _viz_buffer->getAvailableWrite());
 
+                if(_visualizer_callback)
+                    _visualizer_callback();
+
                 ++frames_written;
             }
 
@@ -121,11 +151,24 @@ protected:
         return frames_written;
     }
 
+    // taken whenever the position changes, other threads never read _buffer_size
+    void snapshot_position() {
+        const int64_t written = static_cast<int64_t>(_current_frame) * _buffer_size;
+        // samples still queued for the output are not heard yet
+        const int64_t queued = static_cast<int64_t>(_sample_buffer->getAvailableRead());
+
+        _written_samples = written;
+        _audible_samples = std::max<int64_t>(written - queued, 0);
+        _last_write_time = std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
     bool write_and_update_pos(const std::vector<float>& buffer) {
         int last_frame = _current_frame;
         _current_frame += write_to_buffer(buffer);
         if(last_frame != _current_frame)
         {
+            snapshot_position();
+
             notify_position_update();
             return true;
         } else {
@@ -240,6 +283,88 @@ protected:
         return file;
     }
 
+    // empty if there is no cache
+    std::string analysis_cache_filename(const DecodedFile& file, const std::string& extension) const {
+        if(_analysis_cache_dir.empty()) {
+            return "";
+        }
+
+        // FNV-1a, stable between runs and standard libraries unlike std::hash
+        uint64_t key = 14695981039346656037ULL;
+        auto mix = [&key](const void* data, size_t size) {
+            for(size_t i = 0; i < size; ++i) {
+                key = (key ^ static_cast<const unsigned char*>(data)[i]) * 1099511628211ULL;
+            }
+        };
+
+        // an edited file gets a new key
+        std::error_code error;
+        const uint64_t file_size = std::filesystem::file_size(file.filename, error);
+        const int64_t modified = std::filesystem::last_write_time(file.filename, error).time_since_epoch().count();
+        const uint64_t samples = file.data->samples.size();
+
+        mix(file.filename.data(), file.filename.size());
+        mix(&file_size, sizeof(file_size));
+        mix(&modified, sizeof(modified));
+        mix(&samples, sizeof(samples));
+
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+        return _analysis_cache_dir + "/" + name + extension;
+    }
+
+    // load a waveform overview from the disk cache or build it in the background
+    std::shared_ptr<PeakPyramid> build_peaks(const DecodedFile& file) {
+        const int64_t frames = file.data->samples.size() / std::max(file.data->channelCount, 1);
+        const std::string cache_filename = analysis_cache_filename(file, ".peaks");
+
+        if(!cache_filename.empty()) {
+            auto cached = PeakPyramid::load(cache_filename, frames);
+            if(cached) {
+                notify_peaks_ready();
+                return cached;
+            }
+        }
+
+        return PeakPyramid::compute_async(file.data, _pool,
+                                          [this, cache_filename](const std::shared_ptr<PeakPyramid>& pyramid) {
+            if(!cache_filename.empty()) {
+                pyramid->save(cache_filename);
+            }
+
+            notify_peaks_ready();
+        });
+    }
+
+    // load a track tempo from the disk cache or estimate it once the spectrogram is ready
+    std::shared_ptr<Spectrogram> build_spectrogram_and_tempo(DecodedFile& file) {
+        auto tempo = std::make_shared<TempoEstimate>();
+        const std::string cache_filename = analysis_cache_filename(file, ".tempo");
+
+        if(!cache_filename.empty()) {
+            std::ifstream cached(cache_filename);
+            float bpm = 0;
+            if(cached >> bpm) {
+                tempo->set_bpm(bpm);
+            }
+        }
+
+        file.tempo = tempo;
+
+        return Spectrogram::compute_async(file.data, _pool,
+                                          [tempo, cache_filename](const std::shared_ptr<Spectrogram>& spectrogram) {
+            if(tempo->ready()) {
+                return;
+            }
+
+            tempo->set_bpm(estimate_track_bpm(*spectrogram));
+
+            if(!cache_filename.empty() && tempo->ready()) {
+                std::ofstream(cache_filename) << tempo->bpm();
+            }
+        });
+    }
+
     void recalculate_lengths() {
         if(_current_file.loaded) {
             _track_frame_length = ((int) _current_file.data->samples.size()) / _buffer_size;
@@ -260,6 +385,10 @@ public:
           _pause(true),
           _volume(1.0),
           _current_frame(0),
+          _samples_per_second(0),
+          _last_write_time(0),
+          _written_samples(0),
+          _audible_samples(0),
           _buffer_size(default_buffer_size * default_ring_size),
           _track_frame_length(0),
           _track_length_msec(0),
@@ -282,7 +411,17 @@ public:
         if(is_cached(filename) || is_cached_future(filename))
             return;
 
-        std::future<DecodedFile> future_file = _pool.push(Decoder::decode_to_cache_async, filename);
+        // spectrogram is computed by separate jobs, so the file is available right after decoding
+        std::future<DecodedFile> future_file = _pool.push([this](int thread_id, const std::string& name) {
+            DecodedFile file = Decoder::decode_to_cache_async(thread_id, name);
+
+            if(file.loaded) {
+                file.spectrogram = build_spectrogram_and_tempo(file);
+                file.peaks = build_peaks(file);
+            }
+
+            return file;
+        }, filename);
         _future_cached_files[filename] = std::move(future_file);
     }
 
@@ -339,7 +478,13 @@ public:
             return false;
         }
 
+        std::atomic_store(&_current_spectrogram, _current_file.spectrogram);
+        std::atomic_store(&_current_peaks, _current_file.peaks);
+        std::atomic_store(&_current_tempo, _current_file.tempo);
+
         if(_current_file.data) {
+            _samples_per_second = _current_file.data->sampleRate * _current_file.data->channelCount;
+
             int new_buffer_size = buffer_size_by_sample_rate(_current_file.data->sampleRate);
 
             qDebug() << "buffer size" << new_buffer_size << _buffer_size;
@@ -367,8 +512,15 @@ public:
         stop();
 
         _current_file.data.reset();
+        _current_file.spectrogram.reset();
+        _current_file.peaks.reset();
+        _current_file.tempo.reset();
         _current_file.loaded = false;
 
+        std::atomic_store(&_current_spectrogram, std::shared_ptr<Spectrogram>());
+        std::atomic_store(&_current_peaks, std::shared_ptr<PeakPyramid>());
+        std::atomic_store(&_current_tempo, std::shared_ptr<TempoEstimate>());
+
         _track_frame_length = 0;
         _track_length_msec = 0;
     }
@@ -383,7 +535,9 @@ public:
     void stop_thread() {
         stop();
         _running = false;
-        _decoder_thread.join();
+
+        if(_decoder_thread.joinable())
+            _decoder_thread.join();
     }
 
     void start() { _pause = false; }
@@ -393,6 +547,7 @@ public:
     void stop() {
         _pause = true;
         _current_frame = 0;
+        snapshot_position();
         notify_position_update();
     }
 
@@ -403,6 +558,25 @@ public:
 
     std::string current_file() const { return _current_file.filename; }
 
+    // decoded samples of the current track, empty if nothing is loaded
+    std::shared_ptr<nqr::AudioData> current_audio() const { return _current_file.data; }
+
+    // safe to call from any thread
+    std::shared_ptr<Spectrogram> current_spectrogram() const {
+        return std::atomic_load(&_current_spectrogram);
+    }
+
+    // safe to call from any thread, check ready() before use
+    std::shared_ptr<PeakPyramid> current_peaks() const {
+        return std::atomic_load(&_current_peaks);
+    }
+
+    // tempo of the current track, 0 if unknown. Safe to call from any thread
+    float current_bpm() const {
+        auto tempo = std::atomic_load(&_current_tempo);
+        return tempo ? tempo->bpm() : 0.f;
+    }
+
     bool running() const { return _running; }
     bool playing() const { return !_pause; }
 
@@ -417,6 +591,25 @@ public:
                 : 0;
     }
     int position_frames() const { return _current_frame; }
+
+    // interleaved sample position that is heard now, extrapolated between buffer writes while playing.
+    // Safe to call from any thread
+    int64_t position_samples() const {
+        const int64_t audible = _audible_samples;
+        int64_t samples = audible;
+
+        if(!_pause) {
+            using namespace std::chrono;
+            const auto written_at = steady_clock::time_point(steady_clock::duration(_last_write_time));
+            const double elapsed = duration<double>(steady_clock::now() - written_at).count();
+
+            // never past what was written, the output can not play it yet
+            const int64_t queued = std::max<int64_t>(_written_samples - audible, 0);
+            samples += std::min<int64_t>(static_cast<int64_t>(elapsed * _samples_per_second), queued);
+        }
+
+        return samples;
+    }
     double volume() const { return _volume; }
 
     constexpr int buffer_size() const { return _buffer_size; }
@@ -456,6 +649,7 @@ public:
 
         if(_current_file.loaded) {
             _current_frame = frame;
+            snapshot_position();
         }
     }
 
@@ -480,5 +674,19 @@ public:
     void set_file_end_callback(const DecoderCallbackFn& fn) {
         _file_ended_callback = fn;
     }
+
+    // called from the pool whenever a waveform overview becomes ready
+    void set_peaks_ready_callback(const DecoderCallbackFn& fn) {
+        _peaks_ready_callback = fn;
+    }
+
+    // called from the decode thread whenever samples are written to the visualizer buffer
+    void set_visualizer_callback(const DecoderCallbackFn& fn) {
+        _visualizer_callback = fn;
+    }
+
+    void set_analysis_cache_dir(const std::string& dir) {
+        _analysis_cache_dir = dir;
+    }
 };
 }
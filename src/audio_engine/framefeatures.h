@@ -0,0 +1,55 @@
+#pragma once
+
+#include "types.h"
+#include "triplebuffer.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace audioengine {
+
+// amount of coarse spectrum bands in the features
+constexpr static int feature_band_count = 64;
+
+/*
+ * FrameFeatures are scalar features of one analysis frame.
+ * They are exported to shaders as uniforms, so a shader does not have to
+ * derive them from the spectrum texture for every pixel.
+ */
+struct FrameFeatures {
+    float bpm;            // tempo, 0 if unknown
+    float beat_phase;     // 0 - 1, 0 is on the beat
+    float onset_strength; // about 1 on a typical onset
+
+    // per channel, left first
+    float rms[stereo];
+    float peak[stereo];
+    float centroid[stereo]; // 0 - 1 of the spectrum width
+    float flux[stereo];
+    float low[stereo];      // mean spectrum level below 250 Hz
+    float mid[stereo];      // mean spectrum level in 250 - 4000 Hz
+    float high[stereo];     // mean spectrum level above 4000 Hz
+
+    float bands[feature_band_count]; // normalized mono spectrum averaged to bands
+};
+
+/*
+ * AnalysisFrame is everything the renderer needs from one analysis step,
+ * handed over as a whole so texture and uniforms never mismatch.
+ */
+struct AnalysisFrame {
+    uint16_t texture[analysis_texture_size]; // RGBA half floats, see SpectrumAnalyzer
+    FrameFeatures features;
+};
+
+/*
+ * AnalysisFrameBuffer hands analysis frames to the renderer, which in turn
+ * tells the analyzer what it reads. Stereo spectra and per channel spectral
+ * features cost a second FFT per read once the mono spectrum comes from
+ * the precomputed spectrogram, they are skipped while no shader uses them.
+ */
+struct AnalysisFrameBuffer : TripleBuffer<AnalysisFrame> {
+    std::atomic<bool> stereo_wanted{true};
+};
+
+} // audioengine
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace audioengine {
+
+/*
+ * IEEE 754 binary16 conversion for uploading half float textures.
+ * Rounds to nearest even, keeps infinities and NaN,
+ * flushes values below the smallest subnormal to signed zero.
+ */
+inline uint16_t float_to_half(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t exponent = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    // infinity and NaN
+    if(exponent == 0xffu) {
+        return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+    }
+
+    const int half_exponent = static_cast<int>(exponent) - 127 + 15;
+
+    // overflow to infinity
+    if(half_exponent >= 0x1f) {
+        return static_cast<uint16_t>(sign | 0x7c00u);
+    }
+
+    // subnormal or zero
+    if(half_exponent <= 0) {
+        if(half_exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+
+        mantissa |= 0x800000u;
+        const int shift = 14 - half_exponent;
+        uint32_t half_mantissa = mantissa >> shift;
+
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if(remainder > halfway || (remainder == halfway && (half_mantissa & 1u))) {
+            ++half_mantissa;
+        }
+
+        return static_cast<uint16_t>(sign | half_mantissa);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+
+    // round to nearest even, a carry into the exponent is still correct
+    const uint32_t remainder = mantissa & 0x1fffu;
+    if(remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        ++half;
+    }
+
+    return static_cast<uint16_t>(half);
+}
+
+} // audioengine
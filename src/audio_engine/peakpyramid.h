@@ -0,0 +1,227 @@
+#pragma once
+
+#include "types.h"
+#include "libnyquist/Common.h"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "ctpl_stl.h"
+
+namespace audioengine {
+
+struct PeakBucket {
+    float min;
+    float max;
+    float rms;
+};
+
+/*
+ * PeakPyramid is a multi-resolution min/max/RMS summary of a track,
+ * used to draw a waveform overview at any zoom in constant time.
+ * Level 0 holds the finest buckets, every next level is coarser.
+ */
+class PeakPyramid
+{
+public:
+    constexpr static int levels = 3;
+    constexpr static std::array<int, levels> bucket_sizes = {{ 256, 4096, 65536 }};
+
+private:
+    constexpr static uint32_t file_magic = 0x4b504e54; // "TNPK"
+    constexpr static uint32_t file_version = 1;
+
+    int64_t _frames;
+    std::array<std::vector<PeakBucket>, levels> _levels;
+    std::atomic<int> _slices_left;
+
+    PeakPyramid(int64_t frames) : _frames(frames), _slices_left(0) {
+        for(int level = 0; level < levels; ++level) {
+            _levels[level].resize((frames + bucket_sizes[level] - 1) / bucket_sizes[level]);
+        }
+    }
+
+    // summarize frames [first, last), first is aligned to the coarsest bucket
+    void compute_slice(const nqr::AudioData& audio, int channels, int64_t first, int64_t last) {
+        const int64_t total_samples = audio.samples.size();
+
+        // finest level from the samples
+        for(int64_t begin = first; begin < last; begin += bucket_sizes[0]) {
+            const int64_t end = std::min(begin + bucket_sizes[0], last);
+            const int64_t sample_end = std::min(end * channels, total_samples);
+
+            PeakBucket bucket {1.f, -1.f, 0.f};
+            double square_sum = 0;
+
+            for(int64_t i = begin * channels; i < sample_end; ++i) {
+                const float sample = audio.samples[i];
+
+                bucket.min = std::min(bucket.min, sample);
+                bucket.max = std::max(bucket.max, sample);
+                square_sum += sample * sample;
+            }
+
+            const int64_t count = sample_end - begin * channels;
+            bucket.rms = count > 0 ? static_cast<float>(std::sqrt(square_sum / count)) : 0.f;
+            if(count <= 0) {
+                bucket.min = bucket.max = 0.f;
+            }
+
+            _levels[0][begin / bucket_sizes[0]] = bucket;
+        }
+
+        // coarser levels from the finer ones
+        for(int level = 1; level < levels; ++level) {
+            const int ratio = bucket_sizes[level] / bucket_sizes[level - 1];
+            const auto& finer = _levels[level - 1];
+
+            for(int64_t begin = first; begin < last; begin += bucket_sizes[level]) {
+                const int64_t index = begin / bucket_sizes[level];
+                const int64_t finer_begin = index * ratio;
+                const int64_t finer_end = std::min<int64_t>(finer_begin + ratio, finer.size());
+
+                PeakBucket bucket {1.f, -1.f, 0.f};
+                double square_sum = 0;
+
+                for(int64_t i = finer_begin; i < finer_end; ++i) {
+                    bucket.min = std::min(bucket.min, finer[i].min);
+                    bucket.max = std::max(bucket.max, finer[i].max);
+                    square_sum += finer[i].rms * finer[i].rms;
+                }
+
+                bucket.rms = static_cast<float>(std::sqrt(square_sum / std::max<int64_t>(finer_end - finer_begin, 1)));
+                _levels[level][index] = bucket;
+            }
+        }
+    }
+
+public:
+    /*
+     * Start building a pyramid of the data on the pool, one job per pool thread.
+     * Callback is called from the pool once the pyramid is ready.
+     */
+    static std::shared_ptr<PeakPyramid> compute_async(const std::shared_ptr<nqr::AudioData>& audio,
+                                                      ctpl::thread_pool& pool,
+                                                      const std::function<void(const std::shared_ptr<PeakPyramid>&)>& ready_callback = nullptr)
+    {
+        const int channels = std::max(audio->channelCount, 1);
+        const int64_t frames = audio->samples.size() / channels;
+
+        std::shared_ptr<PeakPyramid> pyramid(new PeakPyramid(frames));
+
+        // slices are aligned to the coarsest bucket, so each job builds all levels by itself
+        const int64_t coarsest = bucket_sizes[levels - 1];
+        const int64_t coarse_buckets = (frames + coarsest - 1) / coarsest;
+        const int64_t slices = std::max<int64_t>(1, std::min<int64_t>(pool.size(), coarse_buckets));
+        const int64_t slice_length = ((coarse_buckets + slices - 1) / slices) * coarsest;
+
+        if(!frames) {
+            if(ready_callback)
+                ready_callback(pyramid);
+            return pyramid;
+        }
+
+        pyramid->_slices_left = static_cast<int>((frames + slice_length - 1) / slice_length);
+
+        for(int64_t first = 0; first < frames; first += slice_length) {
+            const int64_t last = std::min(first + slice_length, frames);
+
+            pool.push([pyramid, audio, channels, first, last, ready_callback](int /*thread_id*/) {
+                pyramid->compute_slice(*audio, channels, first, last);
+
+                if(pyramid->_slices_left.fetch_sub(1, std::memory_order_acq_rel) == 1
+                        && ready_callback) {
+                    ready_callback(pyramid);
+                }
+            });
+        }
+
+        return pyramid;
+    }
+
+    // returns nullptr if the file is missing or does not match
+    static std::shared_ptr<PeakPyramid> load(const std::string& filename, int64_t frames) {
+        std::ifstream file(filename, std::ios::binary);
+        if(!file) {
+            return nullptr;
+        }
+
+        uint32_t magic = 0, version = 0;
+        int64_t stored_frames = 0;
+
+        file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+        file.read(reinterpret_cast<char*>(&version), sizeof(version));
+        file.read(reinterpret_cast<char*>(&stored_frames), sizeof(stored_frames));
+
+        if(!file || magic != file_magic || version != file_version || stored_frames != frames) {
+            return nullptr;
+        }
+
+        std::shared_ptr<PeakPyramid> pyramid(new PeakPyramid(frames));
+        for(auto& level : pyramid->_levels) {
+            file.read(reinterpret_cast<char*>(level.data()), level.size() * sizeof(PeakBucket));
+        }
+
+        return file ? pyramid : nullptr;
+    }
+
+    bool save(const std::string& filename) const {
+        assert(ready());
+
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if(!file) {
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(&file_magic), sizeof(file_magic));
+        file.write(reinterpret_cast<const char*>(&file_version), sizeof(file_version));
+        file.write(reinterpret_cast<const char*>(&_frames), sizeof(_frames));
+
+        for(const auto& level : _levels) {
+            file.write(reinterpret_cast<const char*>(level.data()), level.size() * sizeof(PeakBucket));
+        }
+
+        return static_cast<bool>(file);
+    }
+
+    bool ready() const { return _slices_left.load(std::memory_order_acquire) == 0; }
+
+    int64_t frames() const { return _frames; }
+
+    const std::vector<PeakBucket>& level(int index) const { return _levels[index]; }
+
+    // merge buckets of a level over [begin, end) of its indices
+    PeakBucket summarize(int level_index, int64_t begin, int64_t end) const {
+        const auto& level = _levels[level_index];
+
+        begin = std::max<int64_t>(0, begin);
+        end = std::min<int64_t>(std::max(end, begin + 1), level.size());
+
+        PeakBucket bucket {0.f, 0.f, 0.f};
+        if(begin >= end) {
+            return bucket;
+        }
+
+        bucket = level[begin];
+        double square_sum = bucket.rms * bucket.rms;
+
+        for(int64_t i = begin + 1; i < end; ++i) {
+            bucket.min = std::min(bucket.min, level[i].min);
+            bucket.max = std::max(bucket.max, level[i].max);
+            square_sum += level[i].rms * level[i].rms;
+        }
+
+        bucket.rms = static_cast<float>(std::sqrt(square_sum / (end - begin)));
+        return bucket;
+    }
+};
+
+} // audioengine
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "types.h"
+#include "kiss_fft.h"
+#include "libnyquist/Common.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "ctpl_stl.h"
+
+#ifndef _MSC_VER
+#include <cmath>
+#else
+#define _USE_MATH_DEFINES
+#include <math.h>
+#endif
+
+namespace audioengine {
+
+/*
+ * Spectrogram is a whole-track STFT magnitude spectrogram.
+ * Values are quantized to 8 bit in the same normalized dB scale
+ * SpectrumAnalyzer outputs, so a row can replace a live FFT frame directly.
+ * It is filled in the background by one job per time slice.
+ */
+class Spectrogram
+{
+    const int _bins;
+    const int _hop;
+    const int _channels;
+    const int _sample_rate;
+    const int _frames;
+
+    std::vector<uint8_t> _data;
+    std::atomic<int> _slices_left;
+
+    Spectrogram(int frames, int channels, int sample_rate) :
+        _bins(default_fft_size),
+        _hop(default_spectrogram_hop),
+        _channels(channels),
+        _sample_rate(sample_rate),
+        _frames(frames),
+        _data(static_cast<size_t>(frames) * default_fft_size),
+        _slices_left(0)
+    {
+    }
+
+    // compute rows [first, last) of the spectrogram
+    void compute_slice(const nqr::AudioData& audio, int first, int last) {
+        const int window_size = _bins * 2;
+        const int64_t total_frames = audio.samples.size() / _channels;
+
+        std::vector<float> window(window_size);
+        for(int i = 0; i < window_size; ++i) {
+            window[i] = 0.5f * (1.f - std::cos(2.f * float(M_PI) * i / (float) window_size));
+        }
+
+        std::vector<kiss_fft_cpx> fft_in(window_size), fft_out(window_size);
+        kiss_fft_cfg cfg = kiss_fft_alloc(window_size, 0, NULL, NULL);
+
+        constexpr double range_db = fft_high_bound_db - fft_low_bound_db;
+
+        for(int frame = first; frame < last; ++frame) {
+            const int64_t start = static_cast<int64_t>(frame) * _hop;
+
+            // mix down to mono and apply the window
+            for(int i = 0; i < window_size; ++i) {
+                float sample = 0.f;
+
+                if(start + i < total_frames) {
+                    const float* in = &audio.samples[(start + i) * _channels];
+                    for(int c = 0; c < _channels; ++c) {
+                        sample += in[c];
+                    }
+                    sample /= _channels;
+                }
+
+                fft_in[i].r = sample * window[i];
+                fft_in[i].i = 0;
+            }
+
+            kiss_fft(cfg, fft_in.data(), fft_out.data());
+
+            // quantize the magnitude in a dB scale
+            uint8_t* out = &_data[static_cast<size_t>(frame) * _bins];
+            for(int i = 0; i < _bins; ++i) {
+                const auto& x = fft_out[i];
+                double magnitude_db = 10 * std::log10(x.r * x.r + x.i * x.i);
+                magnitude_db = std::max(fft_low_bound_db, std::min(fft_high_bound_db, magnitude_db));
+
+                out[i] = static_cast<uint8_t>((magnitude_db - fft_low_bound_db) / range_db * 255. + 0.5);
+            }
+        }
+
+        kiss_fft_free(cfg);
+    }
+
+public:
+    /*
+     * Start computing a spectrogram of the data on the pool.
+     * The track is split into time slices, one job per pool thread.
+     * Result is usable as soon as ready() returns true.
+     * Callback is called from the pool once the spectrogram is ready.
+     */
+    static std::shared_ptr<Spectrogram> compute_async(const std::shared_ptr<nqr::AudioData>& audio,
+                                                      ctpl::thread_pool& pool,
+                                                      const std::function<void(const std::shared_ptr<Spectrogram>&)>& ready_callback = nullptr)
+    {
+        const int channels = std::max(audio->channelCount, 1);
+        const int64_t total_frames = audio->samples.size() / channels;
+        const int frames = static_cast<int>((total_frames + default_spectrogram_hop - 1) / default_spectrogram_hop);
+
+        std::shared_ptr<Spectrogram> spectrogram(new Spectrogram(frames, channels, audio->sampleRate));
+
+        if(!frames) {
+            if(ready_callback)
+                ready_callback(spectrogram);
+            return spectrogram;
+        }
+
+        const int slices = std::max(1, std::min(pool.size(), frames));
+        const int slice_length = (frames + slices - 1) / slices;
+
+        spectrogram->_slices_left = (frames + slice_length - 1) / slice_length;
+
+        for(int first = 0; first < frames; first += slice_length) {
+            const int last = std::min(first + slice_length, frames);
+
+            pool.push([spectrogram, audio, first, last, ready_callback](int /*thread_id*/) {
+                spectrogram->compute_slice(*audio, first, last);
+
+                if(spectrogram->_slices_left.fetch_sub(1, std::memory_order_acq_rel) == 1
+                        && ready_callback) {
+                    ready_callback(spectrogram);
+                }
+            });
+        }
+
+        return spectrogram;
+    }
+
+    bool ready() const { return _slices_left.load(std::memory_order_acquire) == 0; }
+
+    int bins() const { return _bins; }
+    int frames() const { return _frames; }
+    int hop() const { return _hop; }
+
+    // rows per second
+    double frame_rate() const { return _hop ? _sample_rate / double(_hop) : 0.; }
+
+    // row index for an interleaved sample position
+    int frame_at(int64_t sample_index) const {
+        if(!_frames) {
+            return 0;
+        }
+
+        int64_t frame = (sample_index / _channels) / _hop;
+        return static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(frame, _frames - 1)));
+    }
+
+    const uint8_t* row(int frame) const {
+        return &_data[static_cast<size_t>(frame) * _bins];
+    }
+
+    // read a row back in dB
+    template <typename T>
+    void read_row_db(int frame, std::vector<T>& out) const {
+        constexpr T range_db = fft_high_bound_db - fft_low_bound_db;
+
+        out.resize(_bins);
+
+        const uint8_t* in = row(frame);
+        for(int i = 0; i < _bins; ++i) {
+            out[i] = fft_low_bound_db + in[i] / T(255) * range_db;
+        }
+    }
+};
+
+} // audioengine
@@ -2,12 +2,20 @@
 
 #include "types.h"
 #include "ringbuffer.h"
+#include "spectrogram.h"
+#include "beattracker.h"
+#include "framefeatures.h"
+#include "halffloat.h"
+#include "triplebuffer.h"
 #include "kiss_fft.h"
 
 #include <vector>
 #include <memory>
 #include <thread>
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <mutex>
 #ifndef _MSC_VER
 #include <cmath>
@@ -18,8 +26,22 @@
 
 namespace audioengine {
 
+using SpectrogramSourceFn = std::function<std::shared_ptr<Spectrogram>()>;
+using PlayheadFn = std::function<int64_t()>;
+using TempoSourceFn = std::function<float()>;
+
 /*
  * SpectrumAnalyzer applies a FFT to a buffer frame and outputs in into a ringbuffer.
+ * If a precomputed spectrogram of the track is ready, spectrum is taken from it
+ * at the playhead instead.
+ * It also tracks onsets and beats and outputs them along with
+ * per channel levels and spectral features as frame features.
+ *
+ * Spectrum and waveform are output together as one RGBA16F texture
+ * of analysis_texture_rows rows by analysis_texture_width texels:
+ *  row 0 - spectrum: mono, left, right, side
+ *  row 1 - waveform: mono, then left, right and side of
+ *          the decimated goniometer points
  */
 class SpectrumAnalyzer
 {
@@ -27,16 +49,53 @@ class SpectrumAnalyzer
     std::shared_ptr<RingBuffer> _source;
     std::atomic<bool> _running;
     std::function<void()> _update_callback;
+    std::atomic<int> _sample_rate;
+    SpectrogramSourceFn _spectrogram_source;
+    PlayheadFn _playhead;
+    TempoSourceFn _tempo_source;
+
+    // wakes the thread while it is idle
+    std::mutex _wake_mutex;
+    std::condition_variable _wake;
+    bool _woken;
 
     const int _fft_size;
     const int _audio_read_size;
 
+    kiss_fft_cfg _fft_cfg;
+    std::vector<kiss_fft_cpx> _fft_in, _fft_out;
+
+    // analysis carried from one frame to the next
+    struct State {
+        std::vector<float> wave_interleaved_stereo;
+        std::vector<double> fft_avg, fft_avg_previous;
+        std::vector<double> wave_avg, wave_avg_prev;
+        std::vector<double> mono_db, left_db, right_db, side_db, left_prev, right_prev;
+        std::vector<double> left_avg, right_avg, side_avg;
+        std::vector<double> left_avg_prev, right_avg_prev, side_avg_prev;
+        std::vector<float> scope_left, scope_right, scope_side;
+
+        OnsetDetector onset_detector;
+        BeatTracker beat_tracker;
+        FrameFeatures features;
+    } _state;
+
+    std::chrono::steady_clock::time_point _last_beat_time;
+
     constexpr static int wait_msec = 5;
     constexpr static double smoothing_fft = 0.8;
     constexpr static double smoothing_wave = 0.6;
-    constexpr static double high_fft_bound = 40;
-    constexpr static double low_fft_bound = -64;
+    constexpr static double high_fft_bound = fft_high_bound_db;
+    constexpr static double low_fft_bound = fft_low_bound_db;
     constexpr static int wait_for_silence_iterations = 60;
+    // jumps in the spectrogram longer than this are not smoothed
+    constexpr static int max_smoothed_frame_jump = 4;
+    // longer gaps between frames are treated as a pause by the beat tracker
+    constexpr static double max_beat_frame_gap = 0.25;
+    constexpr static double onset_decay = 0.85;
+    // upper edges of low and mid bands
+    constexpr static double low_band_hz = 250;
+    constexpr static double mid_band_hz = 4000;
 
     template <typename T>
     void hann(std::vector<T>& v) {
@@ -76,128 +135,405 @@ class SpectrumAnalyzer
     }
 
     template <typename T>
-    std::vector<T> calculate_frequency_spectrum(std::vector<T> samples)
+    T clamp_db(T magnitude_db) {
+        return magnitude_db >= high_fft_bound
+                ? high_fft_bound
+                : magnitude_db <= low_fft_bound
+                  ? low_fft_bound
+                  : magnitude_db;
+    }
+
+    /*
+     * Spectra in dB of both channels, their mix and difference from one complex FFT:
+     * left goes to the real part and right to the imaginary part,
+     * and they are separated again by the symmetry of real signal spectra.
+     */
+    template <typename T>
+    void calculate_stereo_spectrum(const std::vector<float>& interleaved_stereo,
+                                   std::vector<T>& mono_db,
+                                   std::vector<T>& left_db,
+                                   std::vector<T>& right_db,
+                                   std::vector<T>& side_db)
     {
-        auto samples_size = samples.size();
-        std::vector<T> output;
+        const int samples_size = _fft_size * 2;
+        const int bins = _fft_size;
+
+        // apply window function and pack channels
+        for(int i = 0; i < samples_size; ++i) {
+            const float window = 0.5f * (1.f - std::cos(2.f * float(M_PI) * i / (float) samples_size));
+            _fft_in[i].r = interleaved_stereo[i * stereo] * window;
+            _fft_in[i].i = interleaved_stereo[i * stereo + 1] * window;
+        }
+
+        kiss_fft(_fft_cfg, _fft_in.data(), _fft_out.data());
+
+        mono_db.resize(bins);
+        left_db.resize(bins);
+        right_db.resize(bins);
+        side_db.resize(bins);
 
-        // apply windows function
-        hann(samples);
+        for(int k = 0; k < bins; ++k) {
+            const kiss_fft_cpx& x = _fft_out[k];
+            const kiss_fft_cpx& y = _fft_out[k ? samples_size - k : 0];
 
-        // convert values for fft
-        std::vector<kiss_fft_cpx> fft_in(samples_size), fft_out(samples_size);
+            // L = (X[k] + conj(X[N - k])) / 2, R = (X[k] - conj(X[N - k])) / 2i
+            const T left_r = (x.r + y.r) / 2, left_i = (x.i - y.i) / 2;
+            const T right_r = (x.i + y.i) / 2, right_i = (y.r - x.r) / 2;
+            const T mono_r = (left_r + right_r) / 2, mono_i = (left_i + right_i) / 2;
+            const T side_r = (left_r - right_r) / 2, side_i = (left_i - right_i) / 2;
 
-        for(auto i = 0; i < samples_size; i++) {
-            fft_in[i].r = samples[i];
-            fft_in[i].i = 0;
+            left_db[k] = clamp_db<T>(10 * std::log10(left_r * left_r + left_i * left_i));
+            right_db[k] = clamp_db<T>(10 * std::log10(right_r * right_r + right_i * right_i));
+            mono_db[k] = clamp_db<T>(10 * std::log10(mono_r * mono_r + mono_i * mono_i));
+            side_db[k] = clamp_db<T>(10 * std::log10(side_r * side_r + side_i * side_i));
         }
+    }
 
-        // calculate fft
-        kiss_fft_cfg mycfg = kiss_fft_alloc(samples_size, 0, NULL, NULL);
-        kiss_fft(mycfg, fft_in.data(), fft_out.data());
+    // RMS and peak of every channel
+    void update_level_features(const std::vector<float>& interleaved_stereo, int frames,
+                               FrameFeatures& features)
+    {
+        for(int channel = 0; channel < stereo; ++channel) {
+            double square_sum = 0;
+            float peak = 0;
+
+            for(int i = channel; i < frames * stereo; i += stereo) {
+                const float sample = interleaved_stereo[i];
+                square_sum += sample * sample;
+                peak = std::max(peak, std::abs(sample));
+            }
 
-        // trim fft result in half
-        fft_out.resize(samples_size / 2);
+            features.rms[channel] = static_cast<float>(std::sqrt(square_sum / frames));
+            features.peak[channel] = peak;
+        }
+    }
+
+    // centroid, flux and band energies of one channel
+    template <typename T>
+    void update_spectral_features(const std::vector<T>& spectrum_db, std::vector<T>& previous,
+                                  int channel, FrameFeatures& features)
+    {
+        const int bins = static_cast<int>(spectrum_db.size());
+        const double bin_hz = _sample_rate > 0 ? _sample_rate / double(bins * 2) : 0;
+        const int low_end = bin_hz > 0 ? std::min(bins, int(low_band_hz / bin_hz) + 1) : bins / 64;
+        const int mid_end = bin_hz > 0 ? std::min(bins, int(mid_band_hz / bin_hz) + 1) : bins / 4;
 
-        // calculate magnitude in a dB scale and output
-        output.reserve(samples_size);
+        previous.resize(bins, 0);
 
-        for(auto &&x : fft_out) {
-            T magnitude_db = 10 * std::log10(x.r * x.r + x.i * x.i);
-            magnitude_db = magnitude_db >= high_fft_bound
-                    ? high_fft_bound
-                    : magnitude_db <= low_fft_bound
-                      ? low_fft_bound
-                      : magnitude_db;
+        double power_sum = 0, weighted_sum = 0, flux = 0;
+        double band_sum[3] = {0, 0, 0};
 
-            output.push_back(magnitude_db);
+        for(int i = 0; i < bins; ++i) {
+            const double level = (spectrum_db[i] - low_fft_bound) / (high_fft_bound - low_fft_bound);
+            const double power = std::pow(10., spectrum_db[i] / 10.);
+
+            power_sum += power;
+            weighted_sum += power * i;
+            flux += std::max(0., level - previous[i]);
+            previous[i] = level;
+
+            band_sum[i < low_end ? 0 : i < mid_end ? 1 : 2] += level;
         }
 
-        free(mycfg);
+        features.centroid[channel] = power_sum > 0 ? float(weighted_sum / power_sum / bins) : 0.f;
+        features.flux[channel] = float(flux / bins);
+        features.low[channel] = float(band_sum[0] / std::max(low_end, 1));
+        features.mid[channel] = float(band_sum[1] / std::max(mid_end - low_end, 1));
+        features.high[channel] = float(band_sum[2] / std::max(bins - mid_end, 1));
+    }
 
-        return output;
+    // coarse spectrum for shaders from the normalized output
+    template <typename T>
+    void update_bands(const std::vector<T>& spectrum, FrameFeatures& features) {
+        const int bins_per_band = std::max(1, static_cast<int>(spectrum.size()) / feature_band_count);
+
+        for(int band = 0; band < feature_band_count; ++band) {
+            T sum = 0;
+            const int first = band * bins_per_band;
+            const int last = std::min(first + bins_per_band, static_cast<int>(spectrum.size()));
+
+            for(int i = first; i < last; ++i) {
+                sum += spectrum[i];
+            }
+
+            features.bands[band] = last > first ? static_cast<float>(sum / (last - first)) : 0.f;
+        }
     }
 
-    void thread_fn()
+    /*
+     * Goniometer points from the whole read, decimated to one row.
+     * Channels are mapped from -1 - 1 to 0 - 1 like the waveform.
+     */
+    void update_scope(const std::vector<float>& interleaved_stereo, int frames,
+                      std::vector<float>& left, std::vector<float>& right, std::vector<float>& side)
     {
-        std::vector<float> wave_interleaved_stereo(_audio_read_size);
-        std::vector<double> fft_avg(_fft_size), fft_avg_previous;
-        std::vector<double> wave_avg(_fft_size), wave_avg_prev;
+        const int decimation = std::max(1, frames / _fft_size);
 
-        bool wave_silenced = true, spectrum_silenced = true;
+        for(int i = 0; i < _fft_size; ++i) {
+            const int frame = std::min(i * decimation, frames - 1);
+            const float l = interleaved_stereo[frame * stereo];
+            const float r = interleaved_stereo[frame * stereo + 1];
 
-        // maximum values ever displayed
-        auto write_all_data = [&]() {
-            fft_avg_out->write(fft_avg.data(), _fft_size);
-            waveform_avg_out->write(wave_avg.data(), _fft_size);
+            left[i] = 0.5f + 0.5f * l;
+            right[i] = 0.5f + 0.5f * r;
+            side[i] = 0.5f + 0.25f * (l - r);
+        }
+    }
 
-            if(_update_callback)
-                _update_callback();
-        };
+    // interleave rows into the RGBA texture layout
+    template <typename T, typename U>
+    void pack_texture_row(uint16_t* texture, int row,
+                          const std::vector<T>& r, const std::vector<U>& g,
+                          const std::vector<U>& b, const std::vector<U>& a)
+    {
+        uint16_t* out = texture + static_cast<size_t>(row) * _fft_size * analysis_texture_channels;
 
-        // initialize
-        std::fill(fft_avg.begin(), fft_avg.end(), 0);
-        std::fill(wave_avg.begin(), wave_avg.end(), 0.5);
+        for(int i = 0; i < _fft_size; ++i, out += analysis_texture_channels) {
+            out[0] = float_to_half(static_cast<float>(r[i]));
+            out[1] = float_to_half(static_cast<float>(g[i]));
+            out[2] = float_to_half(static_cast<float>(b[i]));
+            out[3] = float_to_half(static_cast<float>(a[i]));
+        }
+    }
 
-        write_all_data();
+    std::shared_ptr<Spectrogram> precomputed_spectrogram() const {
+        if(!_spectrogram_source || !_playhead) {
+            return nullptr;
+        }
+
+        auto spectrogram = _spectrogram_source();
+        return spectrogram && spectrogram->ready() ? spectrogram : nullptr;
+    }
+
+    // seconds since the last live beat update, 0 after a pause
+    double live_beat_dt() {
+        const auto now = std::chrono::steady_clock::now();
+        const double dt = std::chrono::duration<double>(now - _last_beat_time).count();
+        _last_beat_time = now;
+
+        return dt > max_beat_frame_gap ? 0 : dt;
+    }
+
+    // onsets and beat phase from a new unsmoothed spectrum
+    void track_beats(const std::vector<double>& spectrum_db, double dt) {
+        FrameFeatures& features = _state.features;
+
+        const float strength = _state.onset_detector.process(spectrum_db);
+        const float known_bpm = _tempo_source ? _tempo_source() : 0.f;
+
+        features.onset_strength = std::max(strength, float(features.onset_strength * onset_decay));
+        features.beat_phase = _state.beat_tracker.process(strength, _state.onset_detector.onset(), dt, known_bpm);
+        features.bpm = _state.beat_tracker.bpm(known_bpm);
+    }
+
+    // smoothed and normalized copy of a live spectrum
+    void smooth_spectrum(const std::vector<double>& spectrum_db,
+                         std::vector<double>& avg, std::vector<double>& prev) {
+        avg = spectrum_db;
+        smooth(avg, prev, smoothing_fft);
+        prev = avg;
+        normalize(avg, low_fft_bound, high_fft_bound);
+    }
+
+    void reset_state() {
+        _state.wave_interleaved_stereo.assign(_audio_read_size, 0.f);
+        _state.fft_avg.assign(_fft_size, 0);
+        _state.wave_avg.assign(_fft_size, 0.5);
+        _state.left_avg.assign(_fft_size, 0);
+        _state.right_avg.assign(_fft_size, 0);
+        _state.side_avg.assign(_fft_size, 0);
+        _state.scope_left.assign(_fft_size, 0.5f);
+        _state.scope_right.assign(_fft_size, 0.5f);
+        _state.scope_side.assign(_fft_size, 0.5f);
+        _state.left_prev.clear();
+        _state.right_prev.clear();
+
+        _state.fft_avg_previous = _state.fft_avg;
+        _state.wave_avg_prev = _state.wave_avg;
+        _state.left_avg_prev = _state.left_avg;
+        _state.right_avg_prev = _state.right_avg;
+        _state.side_avg_prev = _state.side_avg;
+
+        _state.onset_detector.reset();
+        _state.beat_tracker.reset();
+        _state.features = FrameFeatures {};
+
+        _last_beat_time = std::chrono::steady_clock::now();
+    }
+
+    /*
+     * Waveform, stereo spectra and features of the last read, all but the mono spectrum.
+     * The FFT only runs when the mono spectrum is live or a shader reads the stereo spectra.
+     */
+    void analyze_read(bool live_spectrum) {
+        State& s = _state;
+        const std::vector<float>& wave_interleaved_stereo = s.wave_interleaved_stereo;
+
+        // convert to mono
+        const int fft_calc_size = _fft_size * 2;
+        std::vector<double> wave_avg_full(fft_calc_size);
+        for(int i = 0, j = 0; j < fft_calc_size; ++j, i += stereo) {
+            wave_avg_full[j] = (wave_interleaved_stereo[i] + wave_interleaved_stereo[i + 1]) / double(2);
+        }
+
+        std::copy_n(std::begin(wave_avg_full), _fft_size, std::begin(s.wave_avg));
+
+        smooth(s.wave_avg, s.wave_avg_prev, smoothing_wave);
+        s.wave_avg_prev = s.wave_avg;
+        normalize(s.wave_avg, -1., 1.);
+
+        // levels and goniometer come from the samples
+        update_level_features(wave_interleaved_stereo, fft_calc_size, s.features);
+        update_scope(wave_interleaved_stereo, fft_calc_size, s.scope_left, s.scope_right, s.scope_side);
+
+        const bool stereo = frames_out->stereo_wanted.load(std::memory_order_relaxed);
+        if(!live_spectrum && !stereo) {
+            return;
+        }
+
+        calculate_stereo_spectrum(wave_interleaved_stereo, s.mono_db, s.left_db, s.right_db, s.side_db);
+
+        if(stereo) {
+            // per channel features need the live spectra of both channels
+            update_spectral_features(s.left_db, s.left_prev, 0, s.features);
+            update_spectral_features(s.right_db, s.right_prev, 1, s.features);
+
+            // stereo spectra for the texture
+            smooth_spectrum(s.left_db, s.left_avg, s.left_avg_prev);
+            smooth_spectrum(s.right_db, s.right_avg, s.right_avg_prev);
+            smooth_spectrum(s.side_db, s.side_avg, s.side_avg_prev);
+        }
+    }
+
+    // mono spectrum of the last read, when it is not precomputed
+    void update_mono_spectrum(double beat_dt) {
+        State& s = _state;
+
+        s.fft_avg = s.mono_db;
+        track_beats(s.fft_avg, beat_dt);
+
+        smooth(s.fft_avg, s.fft_avg_previous, smoothing_fft);
+        s.fft_avg_previous = s.fft_avg;
+        normalize(s.fft_avg, low_fft_bound, high_fft_bound);
+    }
+
+    void write_all_data() {
+        update_bands(_state.fft_avg, _state.features);
+
+        AnalysisFrame& frame = frames_out->write_buffer();
 
-        fft_avg_previous = fft_avg;
-        wave_avg_prev = wave_avg;
+        pack_texture_row(frame.texture, 0, _state.fft_avg, _state.left_avg, _state.right_avg, _state.side_avg);
+        pack_texture_row(frame.texture, 1, _state.wave_avg, _state.scope_left, _state.scope_right, _state.scope_side);
+        frame.features = _state.features;
+
+        frames_out->publish();
+
+        if(_update_callback)
+            _update_callback();
+    }
+
+    void thread_fn()
+    {
+        State& s = _state;
+
+        bool wave_silenced = true, spectrum_silenced = true;
+        int last_spectrogram_frame = -1;
+
+        // initialize
+        reset_state();
+        write_all_data();
 
         int silence_count = wait_for_silence_iterations;
         while(_running) {
+            auto spectrogram = precomputed_spectrogram();
+            bool updated = false;
+
+            if(!spectrogram) {
+                last_spectrogram_frame = -1;
+            }
+
             // read just a bit
-            bool read_status = _source->read(wave_interleaved_stereo.data(),
+            bool read_status = _source->read(s.wave_interleaved_stereo.data(),
                                              _audio_read_size);
 
             // process values
             if(read_status) {
                 silence_count = 0;
                 wave_silenced = false;
-                spectrum_silenced = false;
                 _source->clear();
 
-                // convert to mono
-                const int fft_calc_size = _fft_size * 2;
-                std::vector<double> wave_avg_full(fft_calc_size);
-                for(int i = 0, j = 0; j < fft_calc_size; ++j, i += stereo) {
-                    wave_avg_full[j] = (wave_interleaved_stereo[i] + wave_interleaved_stereo[i + 1]) / double(2);
+                analyze_read(!spectrogram);
+
+                // mono spectrum, unless it is precomputed
+                if(!spectrogram) {
+                    spectrum_silenced = false;
+                    update_mono_spectrum(live_beat_dt());
                 }
 
-                std::copy_n(std::begin(wave_avg_full), _fft_size, std::begin(wave_avg));
+                updated = true;
+            }
 
-                // get frequency info
-                fft_avg = calculate_frequency_spectrum(wave_avg_full);
+            // follow the playhead, also when paused or scrubbed
+            if(spectrogram) {
+                const int frame = spectrogram->frame_at(_playhead());
+
+                if(frame != last_spectrogram_frame) {
+                    spectrum_silenced = false;
+                    spectrogram->read_row_db(frame, s.fft_avg);
+
+                    if(last_spectrogram_frame >= 0
+                            && std::abs(frame - last_spectrogram_frame) <= max_smoothed_frame_jump) {
+                        track_beats(s.fft_avg, live_beat_dt());
+                        smooth(s.fft_avg, s.fft_avg_previous, smoothing_fft);
+                    } else {
+                        // scrubbed, onsets across the jump are meaningless
+                        s.onset_detector.reset();
+                        s.onset_detector.process(s.fft_avg);
+                    }
 
-                // smooth
-                smooth(fft_avg, fft_avg_previous, smoothing_fft);
-                smooth(wave_avg, wave_avg_prev, smoothing_wave);
+                    s.fft_avg_previous = s.fft_avg;
+                    normalize(s.fft_avg, low_fft_bound, high_fft_bound);
 
-                fft_avg_previous = fft_avg;
-                wave_avg_prev = wave_avg;
+                    last_spectrogram_frame = frame;
+                    updated = true;
+                }
+            }
 
-                normalize(wave_avg, -1., 1.);
-                normalize(fft_avg, low_fft_bound, high_fft_bound);
+            // nothing to read and nothing decaying, every frame would be the same
+            const bool idle = !updated && wave_silenced && (spectrum_silenced || spectrogram);
 
+            if(updated) {
                 // write to ringbuffer
                 write_all_data();
-            } else if(!wave_silenced || !spectrum_silenced) {
+            } else if(!wave_silenced || (!spectrum_silenced && !spectrogram)) {
                 if(silence_count < wait_for_silence_iterations) {
                     ++silence_count;
                 } else {
                     if(!wave_silenced) {
                         wave_silenced = true;
-                        std::fill(wave_avg.begin(), wave_avg.end(), 0.5);
+                        std::fill(s.wave_avg.begin(), s.wave_avg.end(), 0.5);
+
+                        for(auto scope : { &s.scope_left, &s.scope_right, &s.scope_side }) {
+                            std::fill(scope->begin(), scope->end(), 0.5f);
+                        }
+                        for(auto avg : { &s.left_avg, &s.right_avg, &s.side_avg }) {
+                            std::fill(avg->begin(), avg->end(), 0.);
+                        }
+                    }
+
+                    s.features.onset_strength = 0;
+                    for(int channel = 0; channel < stereo; ++channel) {
+                        s.features.rms[channel] = s.features.peak[channel] = s.features.flux[channel] = 0;
                     }
 
-                    if(!spectrum_silenced) {
+                    if(!spectrum_silenced && !spectrogram) {
                         // drop off slowly
                         double max_value = low_fft_bound;
 
-                        dropoff(fft_avg, 0.94);
+                        dropoff(s.fft_avg, 0.94);
 
                         // find out if silenced
-                        for(auto &x : fft_avg) {
+                        for(auto &x : s.fft_avg) {
                             if(max_value < x) {
                                 max_value = x;
                             }
@@ -207,41 +543,131 @@ class SpectrumAnalyzer
                             spectrum_silenced = true;
 
                             // silence completely
-                            std::fill(fft_avg.begin(), fft_avg.end(), low_fft_bound);
+                            std::fill(s.fft_avg.begin(), s.fft_avg.end(), low_fft_bound);
                         }
                     }
                     write_all_data();
                 }
             }
 
-            // FIXME: replace this with 60 Hz polling
-            std::this_thread::sleep_for(std::chrono::milliseconds(16));
+            wait(idle);
+        }
+    }
+
+    /*
+     * Poll at 60 Hz while there is something to analyse. When idle, e.g. paused
+     * with the spectrum decayed, sleep until wake() instead of polling.
+     */
+    void wait(bool idle) {
+        std::unique_lock<std::mutex> lock(_wake_mutex);
+
+        if(idle) {
+            _wake.wait(lock, [this]() { return _woken || !_running; });
+        } else {
+            _wake.wait_for(lock, std::chrono::milliseconds(16), [this]() { return !_running; });
+        }
+
+        _woken = false;
+    }
+
+    void stop_running() {
+        {
+            std::lock_guard<std::mutex> lock(_wake_mutex);
+            _running = false;
         }
+        _wake.notify_one();
     }
 
 
 public:
-    std::shared_ptr<RingBufferT<double>> fft_avg_out, waveform_avg_out;
+    // newest analysis frame for the renderer
+    std::shared_ptr<AnalysisFrameBuffer> frames_out;
 
     SpectrumAnalyzer(std::shared_ptr<RingBuffer> source) :
         _source(source),
         _running(true),
+        _sample_rate(0),
+        _woken(false),
         _fft_size(default_fft_size),
         _audio_read_size(default_fft_read_size),
-        fft_avg_out(std::make_shared<RingBufferT<double>>(_fft_size)),
-        waveform_avg_out(std::make_shared<RingBufferT<double>>(_fft_size))
+        _fft_cfg(kiss_fft_alloc(_fft_size * 2, 0, NULL, NULL)),
+        _fft_in(_fft_size * 2),
+        _fft_out(_fft_size * 2),
+        frames_out(std::make_shared<AnalysisFrameBuffer>())
     {
+        reset_state();
     }
 
     void set_update_callback(const std::function<void()>& callback) {
         _update_callback = callback;
     }
 
+    /*
+     * Take the spectrum from a precomputed spectrogram at the playhead
+     * whenever one is ready. Set before the thread is started.
+     */
+    void set_precomputed_source(const SpectrogramSourceFn& spectrogram_source,
+                                const PlayheadFn& playhead) {
+        _spectrogram_source = spectrogram_source;
+        _playhead = playhead;
+    }
+
+    // sample rate of the current track, used for band edges
+    void set_sample_rate(int sample_rate) {
+        _sample_rate = sample_rate;
+    }
+
+    /*
+     * Known tempo of the current track, 0 if unknown.
+     * Without it the tempo is estimated from recent onsets.
+     * Set before the thread is started.
+     */
+    void set_tempo_source(const TempoSourceFn& tempo_source) {
+        _tempo_source = tempo_source;
+    }
+
+    /*
+     * New input: samples written to the source, the playhead moved
+     * or the spectrogram changed. Safe to call from any thread.
+     */
+    void wake() {
+        {
+            std::lock_guard<std::mutex> lock(_wake_mutex);
+            _woken = true;
+        }
+        _wake.notify_one();
+    }
+
     ~SpectrumAnalyzer()  {
-        _running = false;
+        stop_running();
 
         if(_thread.joinable())
             _thread.join();
+
+        kiss_fft_free(_fft_cfg);
+    }
+
+    // interleaved stereo samples analysed per frame
+    int read_size() const { return _audio_read_size; }
+
+    /*
+     * Analyse one read of read_size() interleaved stereo samples as the frame
+     * dt seconds after the previous one, and publish it to frames_out.
+     * Same steps as the live thread without its clock, so a fixed dt gives
+     * reproducible frames. Only call while the thread is not running.
+     */
+    void process_frame(const float* interleaved_stereo, double dt) {
+        std::copy_n(interleaved_stereo, _audio_read_size, _state.wave_interleaved_stereo.begin());
+
+        analyze_read(true);
+        update_mono_spectrum(dt);
+        write_all_data();
+    }
+
+    // start over from silence, e.g. before offline analysis
+    void reset() {
+        reset_state();
+        write_all_data();
     }
 
     void start_thread() {
@@ -252,8 +678,10 @@ public:
     }
 
     void stop_thread() {
-        _running = false;
-        _thread.join();
+        stop_running();
+
+        if(_thread.joinable())
+            _thread.join();
     }
 
     std::shared_ptr<RingBuffer> source() const;
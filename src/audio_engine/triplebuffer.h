@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace audioengine {
+
+/*
+ * TripleBuffer hands the newest complete value from one writer thread
+ * to one reader thread without locks or allocations.
+ * Writer fills write_buffer() and publishes it, reader calls update()
+ * and reads read_buffer() until the next update. Frames published
+ * while the reader is busy are dropped, only the newest one is kept.
+ */
+template <typename T>
+class TripleBuffer
+{
+    // index of the shared slot, plus a flag that it holds an unread frame
+    constexpr static uint8_t fresh_flag = 0x4;
+    constexpr static uint8_t index_mask = 0x3;
+
+    std::array<T, 3> _slots;
+    std::array<uint64_t, 3> _sequences;
+
+    std::atomic<uint8_t> _shared;
+    uint8_t _write_index;
+    uint8_t _read_index;
+    uint64_t _write_sequence;
+
+public:
+    TripleBuffer() :
+        _slots{},
+        _sequences{{0, 0, 0}},
+        _shared(1),
+        _write_index(0),
+        _read_index(2),
+        _write_sequence(0)
+    {
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // only safe to call from the write thread
+    T& write_buffer() { return _slots[_write_index]; }
+
+    // only safe to call from the write thread
+    void publish() {
+        _sequences[_write_index] = ++_write_sequence;
+
+        const uint8_t previous = _shared.exchange(_write_index | fresh_flag, std::memory_order_acq_rel);
+        _write_index = previous & index_mask;
+    }
+
+    // take the newest published frame, returns false if there is none since the last call
+    // only safe to call from the read thread
+    bool update() {
+        if(!(_shared.load(std::memory_order_relaxed) & fresh_flag)) {
+            return false;
+        }
+
+        const uint8_t previous = _shared.exchange(_read_index, std::memory_order_acq_rel);
+        _read_index = previous & index_mask;
+
+        return true;
+    }
+
+    // only safe to call from the read thread
+    const T& read_buffer() const { return _slots[_read_index]; }
+
+    // sequence number of read_buffer(), 0 before the first frame
+    uint64_t read_sequence() const { return _sequences[_read_index]; }
+};
+
+} // audioengine
@@ -24,6 +24,19 @@ constexpr static int default_fft_size = 256;
 constexpr static int default_fft_read_size = default_fft_size * 4;
 constexpr static int default_fft_buffer_size = default_fft_read_size * default_fft_ring_size;
 
+// spectrum bounds in dB, everything outside is clipped
+constexpr static double fft_high_bound_db = 40;
+constexpr static double fft_low_bound_db = -64;
+
+// analysis texture is RGBA, one row of spectrum and one of waveform
+constexpr static int analysis_texture_rows = 2;
+constexpr static int analysis_texture_channels = 4;
+constexpr static int analysis_texture_width = default_fft_size;
+constexpr static int analysis_texture_size = analysis_texture_width * analysis_texture_rows * analysis_texture_channels;
+
+// defaults for precomputed spectrogram
+constexpr static int default_spectrogram_hop = default_fft_size * 2;
+
 constexpr static int buffer_size_by_sample_rate(int sample_rate) {
     if(sample_rate <= 48000) {
         return default_buffer_size;
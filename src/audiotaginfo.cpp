@@ -1,17 +1,147 @@
 #include "audiotaginfo.h"
+#include "coverartcache.h"
 
 #include "tag.h"
 #include "fileref.h"
 #include "audioproperties.h"
 
+#include "apetag.h"
+#include "attachedpictureframe.h"
+#include "flacfile.h"
+#include "flacpicture.h"
+#include "id3v2tag.h"
+#include "mp4file.h"
+#include "mpegfile.h"
+#include "wavpackfile.h"
+#include "xiphcomment.h"
+
 #include <QFile>
 #include <QFileInfo>
-#include <QUrl>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+// files of an album share a directory, look for its cover once
+static QString directoryCoverUrl(const QString& directory)
+{
+    static QMutex mutex;
+    static QHash<QString, QString> covers;
+
+    {
+        QMutexLocker lock(&mutex);
+
+        auto cover = covers.constFind(directory);
+        if(cover != covers.constEnd() && CoverArtCache::hasThumbnails(*cover)) {
+            return *cover;
+        }
+    }
+
+    // thumbnails of the cover.jpg if it exists
+    QString url;
+    QFile file(directory + "/cover.jpg");
+    if(file.open(QIODevice::ReadOnly)) {
+        const QString id = CoverArtCache::insert(file.readAll());
+        if(!id.isEmpty()) {
+            url = CoverArtCache::url(id);
+        }
+    }
+
+    QMutexLocker lock(&mutex);
+    covers.insert(directory, url);
+
+    return url;
+}
+
+static QByteArray toByteArray(const TagLib::ByteVector& data)
+{
+    return QByteArray(data.data(), static_cast<int>(data.size()));
+}
+
+// the front cover if it is marked, the first picture otherwise
+template <typename Picture>
+static const Picture* pickPicture(const TagLib::List<Picture*>& pictures)
+{
+    const Picture* picked = nullptr;
+    for(const Picture* picture : pictures) {
+        if(!picture) {
+            continue;
+        }
+        if(picture->type() == Picture::FrontCover) {
+            return picture;
+        }
+        if(!picked) {
+            picked = picture;
+        }
+    }
+
+    return picked;
+}
+
+// picture in the tags, they are read already so it costs no file access
+static QByteArray embeddedCover(const TagLib::FileRef& file)
+{
+    // ID3v2 APIC frames
+    if(auto mpeg = dynamic_cast<TagLib::MPEG::File*>(file.file())) {
+        if(!mpeg->hasID3v2Tag()) {
+            return QByteArray();
+        }
+
+        TagLib::List<TagLib::ID3v2::AttachedPictureFrame*> pictures;
+        for(TagLib::ID3v2::Frame* frame : mpeg->ID3v2Tag()->frameList("APIC")) {
+            pictures.append(dynamic_cast<TagLib::ID3v2::AttachedPictureFrame*>(frame));
+        }
+
+        const auto picture = pickPicture(pictures);
+        return picture ? toByteArray(picture->picture()) : QByteArray();
+    }
+
+    // FLAC PICTURE blocks
+    if(auto flac = dynamic_cast<TagLib::FLAC::File*>(file.file())) {
+        const auto picture = pickPicture(flac->pictureList());
+        return picture ? toByteArray(picture->data()) : QByteArray();
+    }
+
+    // MP4 covr, without picture types
+    if(auto mp4 = dynamic_cast<TagLib::MP4::File*>(file.file())) {
+        if(mp4->tag() && mp4->tag()->contains("covr")) {
+            const TagLib::MP4::CoverArtList covers = mp4->tag()->item("covr").toCoverArtList();
+            if(!covers.isEmpty()) {
+                return toByteArray(covers.front().data());
+            }
+        }
+
+        return QByteArray();
+    }
+
+    // METADATA_BLOCK_PICTURE of Vorbis and Opus
+    if(auto xiph = dynamic_cast<TagLib::Ogg::XiphComment*>(file.tag())) {
+        const auto picture = pickPicture(xiph->pictureList());
+        return picture ? toByteArray(picture->data()) : QByteArray();
+    }
+
+    // APE binary item, a file name and the image
+    if(auto wavpack = dynamic_cast<TagLib::WavPack::File*>(file.file())) {
+        if(wavpack->hasAPETag()) {
+            const TagLib::APE::ItemListMap& items = wavpack->APETag()->itemListMap();
+            const auto item = items.find("COVER ART (FRONT)");
+            if(item != items.end()) {
+                const TagLib::ByteVector data = item->second.binaryData();
+                const int start = data.find('\0') + 1;
+                if(start > 0) {
+                    return toByteArray(data.mid(start));
+                }
+            }
+        }
+    }
+
+    return QByteArray();
+}
 
 AudioTagInfo::AudioTagInfo(const QString& newPath)
     : duration(0)
 {
-    TagLib::FileRef f{ newPath.toUtf8().constData() };
+    // exact durations would need a full scan of VBR files without a header
+    TagLib::FileRef f{ newPath.toUtf8().constData(), true, TagLib::AudioProperties::Fast };
     QFileInfo filePathInfo(newPath);
 
     path = newPath;
@@ -30,8 +160,20 @@ AudioTagInfo::AudioTagInfo(const QString& newPath)
       album = TStringToQString(tag->album());
       artist = TStringToQString(tag->artist());
 
-      // use the cover.jpg as an URL if it exists
-      QFile cover(filePathInfo.path() + "/cover.jpg");
-      coverUrl = cover.exists() ? QUrl::fromLocalFile(cover.fileName()).toString() : "";
+      // decoded and scaled once per distinct picture
+      const QByteArray cover = embeddedCover(f);
+      const QString coverId = cover.isEmpty() ? QString() : CoverArtCache::insert(cover);
+
+      coverUrl = coverId.isEmpty() ? directoryCoverUrl(filePathInfo.path()) : CoverArtCache::url(coverId);
     }
 }
+
+AudioTagInfo AudioTagInfo::placeholder(const QString &path)
+{
+    AudioTagInfo item;
+    item.path = path;
+    item.fileName = QFileInfo(path).fileName();
+    item.duration = 0;
+
+    return item;
+}
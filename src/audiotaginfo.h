@@ -1,6 +1,7 @@
 #ifndef AUDIOTAGINFO_H
 #define AUDIOTAGINFO_H
 
+#include <QMetaType>
 #include <QString>
 
 struct AudioTagInfo
@@ -14,7 +15,15 @@ struct AudioTagInfo
     qint64 duration;
 
     AudioTagInfo() = default;
+
+    //! Reads tags of the file. Audio properties are read fast,
+    //! durations of some VBR files are estimates.
     explicit AudioTagInfo(const QString &path);
+
+    //! File name only, for a row whose tags are not read yet.
+    static AudioTagInfo placeholder(const QString &path);
 };
 
+Q_DECLARE_METATYPE(AudioTagInfo)
+
 #endif // AUDIOTAGINFO_H
@@ -0,0 +1,122 @@
+#include "coverartcache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QVector>
+
+#include <cstring>
+
+constexpr std::array<int, 3> CoverArtCache::sizes;
+
+// JPEG artifacts show on flat colours of small covers below that
+constexpr int thumbnail_quality = 90;
+
+constexpr auto url_prefix = "image://cover/";
+
+// covers with thumbnails, so tracks of an album only hash theirs
+static QMutex mutex;
+static QSet<QString> known;
+
+static QString cacheDirectory()
+{
+    static const QString directory = [] {
+        const QString path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/covers";
+        QDir().mkpath(path);
+        return path;
+    }();
+
+    return directory;
+}
+
+QString CoverArtCache::insert(const QByteArray &image)
+{
+    const QString id = QCryptographicHash::hash(image, QCryptographicHash::Sha1).toHex();
+    {
+        QMutexLocker lock(&mutex);
+        if(known.contains(id)) {
+            return id;
+        }
+    }
+
+    // the largest thumbnail is written last, it is there if all of them are
+    if(!QFileInfo::exists(thumbnailPath(id, sizes.back()))) {
+        QImage scaled;
+        if(!scaled.loadFromData(image)) {
+            qWarning() << "Cover art: could not decode an image of" << image.size() << "bytes";
+            return QString();
+        }
+
+        // each size from the next larger one, the full image is scaled once
+        QVector<QImage> thumbnails(sizes.size());
+        for(int i = sizes.size() - 1; i >= 0; --i) {
+            if(scaled.width() > sizes[i] || scaled.height() > sizes[i]) {
+                scaled = scaled.scaled(sizes[i], sizes[i], Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            }
+            thumbnails[i] = scaled;
+        }
+
+        for(int i = 0; i < thumbnails.size(); ++i) {
+            QSaveFile file(thumbnailPath(id, sizes[i]));
+            if(!file.open(QIODevice::WriteOnly)
+                    || !thumbnails[i].save(&file, "JPG", thumbnail_quality)
+                    || !file.commit()) {
+                qWarning() << "Cover art: could not write" << file.fileName();
+                return QString();
+            }
+        }
+    }
+
+    QMutexLocker lock(&mutex);
+    known.insert(id);
+
+    return id;
+}
+
+QString CoverArtCache::thumbnailPath(const QString &id, int size)
+{
+    return QString("%1/%2_%3.jpg").arg(cacheDirectory(), id).arg(size);
+}
+
+QString CoverArtCache::url(const QString &id)
+{
+    return url_prefix + id;
+}
+
+bool CoverArtCache::hasThumbnails(const QString &url)
+{
+    if(!url.startsWith(url_prefix)) {
+        return true;
+    }
+
+    const QString id = url.mid(static_cast<int>(std::strlen(url_prefix)));
+    {
+        QMutexLocker lock(&mutex);
+        if(known.contains(id)) {
+            return true;
+        }
+    }
+
+    // one stat per cover and session
+    if(!QFileInfo::exists(thumbnailPath(id, sizes.back()))) {
+        return false;
+    }
+
+    QMutexLocker lock(&mutex);
+    known.insert(id);
+
+    return true;
+}
+
+void CoverArtCache::remove(const QString &id)
+{
+    QMutexLocker lock(&mutex);
+    known.remove(id);
+}
@@ -0,0 +1,39 @@
+#ifndef COVERARTCACHE_H
+#define COVERARTCACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <array>
+
+//! Thumbnails of cover images on disk, shared by all files with the same cover.
+//! A cover is identified by the hash of its encoded image, so an album whose
+//! tracks all embed the same picture is decoded and scaled once, in the first
+//! session that sees it. Thumbnails are written for every display size and
+//! served by CoverImageProvider, full size images are never kept.
+//! Safe to use from the tag scanner threads.
+class CoverArtCache
+{
+public:
+    //! Edge lengths of the thumbnails, the provider picks the smallest one that fits a request.
+    static constexpr std::array<int, 3> sizes{{96, 256, 512}};
+
+    //! Hash of an encoded image, after its thumbnails are written.
+    //! Empty if the image can not be decoded.
+    static QString insert(const QByteArray& image);
+
+    //! Thumbnail of a cover at one of sizes, the file may not exist.
+    static QString thumbnailPath(const QString& id, int size);
+
+    //! URL for QML.
+    static QString url(const QString& id);
+
+    //! Whether the thumbnails of a cover URL are on disk, e.g. after the cache was purged.
+    //! True for URLs that are not of this cache.
+    static bool hasThumbnails(const QString& url);
+
+    //! Forget a cover whose thumbnails are gone, the next insert() writes them again.
+    static void remove(const QString& id);
+};
+
+#endif // COVERARTCACHE_H
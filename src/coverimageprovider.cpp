@@ -0,0 +1,50 @@
+#include "coverimageprovider.h"
+
+#include "coverartcache.h"
+
+#include <algorithm>
+
+// thumbnail for requests without a size
+constexpr auto default_size = 256;
+
+CoverImageProvider::CoverImageProvider()
+    : QQuickImageProvider(QQuickImageProvider::Image,
+                          QQuickImageProvider::ForceAsynchronousImageLoading)
+{
+}
+
+QImage CoverImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    // either edge may be left out, covers are about square
+    const int requested = std::max(requestedSize.width(), requestedSize.height());
+    const QSize bounds = requested > 0
+            ? QSize(requestedSize.width() > 0 ? requestedSize.width() : requested,
+                    requestedSize.height() > 0 ? requestedSize.height() : requested)
+            : QSize(default_size, default_size);
+
+    // the largest one if none is large enough
+    int thumbnail = CoverArtCache::sizes.back();
+    for(int candidate : CoverArtCache::sizes) {
+        if(candidate >= std::max(bounds.width(), bounds.height())) {
+            thumbnail = candidate;
+            break;
+        }
+    }
+
+    QImage image(CoverArtCache::thumbnailPath(id, thumbnail));
+
+    // purged from the cache, the next scan of its files extracts it again
+    if(image.isNull()) {
+        CoverArtCache::remove(id);
+    }
+
+    if(!image.isNull() && (image.width() > bounds.width() || image.height() > bounds.height())) {
+        image = image.scaled(bounds, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+
+    if(size) {
+        *size = image.size();
+    }
+
+    return image;
+}
@@ -0,0 +1,17 @@
+#ifndef COVERIMAGEPROVIDER_H
+#define COVERIMAGEPROVIDER_H
+
+#include <QQuickImageProvider>
+
+//! Serves cover thumbnails of CoverArtCache to QML, off the GUI thread.
+//! Image id is the cover id, the thumbnail is the smallest one that
+//! covers the requested size.
+class CoverImageProvider : public QQuickImageProvider
+{
+public:
+    CoverImageProvider();
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+};
+
+#endif // COVERIMAGEPROVIDER_H
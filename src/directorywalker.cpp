@@ -0,0 +1,163 @@
+#include "directorywalker.h"
+
+#include "ctpl_stl.h"
+#include "libnyquist/Decoders.h"
+
+#include <QCollator>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// directories listed at once, more mostly adds seeks
+constexpr int max_parallel_listings = 4;
+
+struct DirectoryWalker::Directory
+{
+    QString path;
+    bool listed = false;
+    QStringList files;
+    std::vector<std::unique_ptr<Directory>> subdirectories;
+};
+
+struct DirectoryWalker::Walk
+{
+    quint64 generation;
+
+    QMutex mutex;
+    Directory root;
+    // directories reported so far with the next subdirectory of each, from the root
+    std::vector<std::pair<Directory*, size_t>> reported;
+    // the one to report once it is listed
+    Directory* next;
+};
+
+DirectoryWalker::DirectoryWalker(QObject *parent)
+    : QObject(parent),
+      m_io(new nqr::NyquistIO()),
+      m_pool(new ctpl::thread_pool(max_parallel_listings)),
+      m_generation(0)
+{
+}
+
+DirectoryWalker::~DirectoryWalker()
+{
+    // queued directories are skipped, the pool only waits for listings in progress
+    cancel();
+    m_pool->stop(true);
+}
+
+void DirectoryWalker::walk(const QString &root)
+{
+    const QFileInfo info(root);
+    if(!info.isDir()) {
+        qWarning() << "Walker:" << root << "is not a directory";
+        return;
+    }
+
+    auto walk = std::make_shared<Walk>();
+    walk->generation = m_generation;
+    walk->root.path = info.absoluteFilePath();
+    walk->next = &walk->root;
+
+    m_pool->push([this, walk](int /* thread_id */) {
+        listDirectory(walk, &walk->root);
+    });
+}
+
+void DirectoryWalker::cancel()
+{
+    ++m_generation;
+}
+
+quint64 DirectoryWalker::generation() const
+{
+    return m_generation;
+}
+
+void DirectoryWalker::listDirectory(const std::shared_ptr<Walk>& walk, Directory* directory)
+{
+    if(m_generation != walk->generation) {
+        return;
+    }
+
+    QStringList files;
+    QStringList directories;
+
+    // one directory at a time, subdirectories become jobs of their own
+    QDirIterator it(directory->path, QDir::AllEntries | QDir::NoDotAndDotDot);
+    while(it.hasNext() && m_generation == walk->generation) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+
+        if(info.isDir()) {
+            // links could lead back up the tree
+            if(!info.isSymLink()) {
+                directories << info.absoluteFilePath();
+            }
+        } else if(m_io->IsFileSupported(info.fileName().toLower().toStdString())) {
+            files << info.absoluteFilePath();
+        }
+    }
+
+    // a partial listing would leave a gap
+    if(m_generation != walk->generation) {
+        return;
+    }
+
+    // track 2 before track 10
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    std::sort(files.begin(), files.end(), collator);
+    std::sort(directories.begin(), directories.end(), collator);
+
+    QMutexLocker lock(&walk->mutex);
+
+    for(const QString& path : directories) {
+        directory->subdirectories.emplace_back(new Directory{path, false, QStringList(), {}});
+
+        Directory* subdirectory = directory->subdirectories.back().get();
+        m_pool->push([this, walk, subdirectory](int /* thread_id */) {
+            listDirectory(walk, subdirectory);
+        });
+    }
+
+    directory->files = files;
+    directory->listed = true;
+
+    reportListed(*walk);
+}
+
+void DirectoryWalker::reportListed(Walk &walk)
+{
+    // in path order, a directory first, then its subdirectories
+    while(walk.next && walk.next->listed) {
+        Directory* directory = walk.next;
+        if(!directory->files.isEmpty()) {
+            emit filesFound(walk.generation, directory->files);
+            directory->files.clear();
+        }
+
+        walk.reported.emplace_back(directory, 0);
+        walk.next = nullptr;
+
+        while(!walk.reported.empty()) {
+            auto& parent = walk.reported.back();
+            if(parent.second < parent.first->subdirectories.size()) {
+                walk.next = parent.first->subdirectories[parent.second++].get();
+                break;
+            }
+
+            // every directory below it is reported
+            parent.first->subdirectories.clear();
+            walk.reported.pop_back();
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef DIRECTORYWALKER_H
+#define DIRECTORYWALKER_H
+
+#include <QObject>
+#include <QStringList>
+
+#include <atomic>
+#include <memory>
+
+namespace ctpl {
+class thread_pool;
+}
+
+namespace nqr {
+class NyquistIO;
+}
+
+//! Finds the playable files under directories on a thread pool.
+//! Every directory is listed by its own job and its subdirectories are
+//! queued as new jobs, the pool size bounds how many directories are
+//! read at once, which keeps network shares and spinning disks responsive.
+//! Files of a directory are reported together in path order, a directory
+//! listed early waits for the ones before it, so a tree imports the same
+//! way every time.
+class DirectoryWalker : public QObject
+{
+    Q_OBJECT
+
+    struct Directory;
+    struct Walk;
+
+    std::unique_ptr<nqr::NyquistIO> m_io;
+    std::unique_ptr<ctpl::thread_pool> m_pool;
+
+    // bumped by cancel(), jobs of older walks stop early
+    std::atomic<quint64> m_generation;
+
+    void listDirectory(const std::shared_ptr<Walk>& walk, Directory* directory);
+    void reportListed(Walk& walk);
+
+public:
+    explicit DirectoryWalker(QObject* parent = nullptr);
+    ~DirectoryWalker();
+
+    //! Walk a directory tree in the background.
+    void walk(const QString& root);
+
+    //! Stop every walk, directories already reported stay reported.
+    void cancel();
+
+    //! Walks started now report this, batches of cancelled walks can be told apart.
+    quint64 generation() const;
+
+signals:
+    //! Emitted from a pool thread with the supported files of one directory, sorted by name.
+    //! Batches of one walk arrive in path order.
+    void filesFound(quint64 generation, const QStringList& paths);
+};
+
+#endif // DIRECTORYWALKER_H
@@ -0,0 +1,307 @@
+#include "libraryindex.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QSaveFile>
+#include <QVector>
+#include <QWriteLocker>
+
+#include <algorithm>
+#include <cstring>
+
+// bump when the layout or the meaning of a field changes, older files are dropped
+constexpr quint32 index_version = 2;
+constexpr char index_magic[4] = {'T', 'L', 'I', 'X'};
+
+struct LibraryIndexHeader {
+    char magic[4];
+    quint32 version;
+    quint32 count;
+    quint32 reserved;
+};
+
+// strings are offsets into the string table that follows the records,
+// each one a quint32 byte length and UTF-8 bytes
+struct LibraryIndex::Record {
+    quint64 hash;
+    qint64 size;
+    qint64 modified;
+    qint64 duration;
+    // room for analysis results, 0 while unknown
+    float bpm;
+    float loudness;
+    quint32 path;
+    quint32 song;
+    quint32 album;
+    quint32 artist;
+    quint32 cover;
+    quint32 reserved;
+};
+
+static_assert(sizeof(LibraryIndexHeader) == 16, "LibraryIndexHeader must not be padded");
+
+// stable between runs, unlike qHash
+static quint64 pathHash(const QString& path)
+{
+    const QByteArray bytes = path.toUtf8();
+
+    quint64 hash = 14695981039346656037ULL;
+    for(char c : bytes) {
+        hash = (hash ^ static_cast<uchar>(c)) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static qint64 modifiedTime(const QFileInfo& file)
+{
+    return file.lastModified().toMSecsSinceEpoch();
+}
+
+LibraryIndex::LibraryIndex()
+    : m_map(nullptr),
+      m_mapSize(0)
+{
+    static_assert(sizeof(Record) == 64, "LibraryIndex::Record must not be padded");
+}
+
+LibraryIndex::~LibraryIndex()
+{
+    unmap();
+}
+
+void LibraryIndex::open(const QString &fileName)
+{
+    QWriteLocker lock(&m_lock);
+
+    unmap();
+    m_fileName = fileName;
+    map();
+}
+
+void LibraryIndex::map()
+{
+    m_file.setFileName(m_fileName);
+    if(!m_file.exists() || !m_file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const qint64 size = m_file.size();
+    const uchar* data = size >= static_cast<qint64>(sizeof(LibraryIndexHeader)) ? m_file.map(0, size) : nullptr;
+
+    const auto header = reinterpret_cast<const LibraryIndexHeader*>(data);
+    if(!header
+            || std::memcmp(header->magic, index_magic, sizeof(index_magic)) != 0
+            || header->version != index_version
+            || sizeof(LibraryIndexHeader) + quint64(header->count) * sizeof(Record) > quint64(size)) {
+        qWarning() << "Library index: ignoring" << m_fileName;
+        unmap();
+        return;
+    }
+
+    m_map = data;
+    m_mapSize = size;
+}
+
+void LibraryIndex::unmap()
+{
+    if(m_map) {
+        m_file.unmap(const_cast<uchar*>(m_map));
+    }
+    m_file.close();
+
+    m_map = nullptr;
+    m_mapSize = 0;
+}
+
+const LibraryIndex::Record *LibraryIndex::records() const
+{
+    return reinterpret_cast<const Record*>(m_map + sizeof(LibraryIndexHeader));
+}
+
+quint32 LibraryIndex::count() const
+{
+    return m_map ? reinterpret_cast<const LibraryIndexHeader*>(m_map)->count : 0;
+}
+
+QString LibraryIndex::string(quint32 offset) const
+{
+    const quint64 table = sizeof(LibraryIndexHeader) + quint64(count()) * sizeof(Record);
+    const quint64 position = table + offset;
+
+    quint32 length = 0;
+    if(position + sizeof(length) > quint64(m_mapSize)) {
+        return QString();
+    }
+    std::memcpy(&length, m_map + position, sizeof(length));
+
+    if(position + sizeof(length) + length > quint64(m_mapSize)) {
+        return QString();
+    }
+
+    return QString::fromUtf8(reinterpret_cast<const char*>(m_map + position + sizeof(length)), length);
+}
+
+const LibraryIndex::Record *LibraryIndex::findRecord(const QString &path) const
+{
+    const quint64 hash = pathHash(path);
+    const Record* first = records();
+    const Record* last = first + count();
+
+    auto record = std::lower_bound(first, last, hash, [](const Record& record, quint64 hash) {
+        return record.hash < hash;
+    });
+
+    // colliding hashes are next to each other
+    for(; record != last && record->hash == hash; ++record) {
+        if(string(record->path) == path) {
+            return record;
+        }
+    }
+
+    return nullptr;
+}
+
+bool LibraryIndex::find(const QFileInfo &file, AudioTagInfo &tags) const
+{
+    const QString path = file.absoluteFilePath();
+    const qint64 size = file.size();
+    const qint64 modified = modifiedTime(file);
+
+    QReadLocker lock(&m_lock);
+
+    auto entry = m_pending.constFind(path);
+    if(entry != m_pending.constEnd()) {
+        if(entry->size != size || entry->modified != modified) {
+            return false;
+        }
+
+        tags = entry->tags;
+        return true;
+    }
+
+    const Record* record = m_map ? findRecord(path) : nullptr;
+    if(!record || record->size != size || record->modified != modified) {
+        return false;
+    }
+
+    tags = AudioTagInfo::placeholder(path);
+    tags.duration = record->duration;
+    tags.song = string(record->song);
+    tags.album = string(record->album);
+    tags.artist = string(record->artist);
+    tags.coverUrl = string(record->cover);
+
+    return true;
+}
+
+void LibraryIndex::insert(const QFileInfo &file, const AudioTagInfo &tags)
+{
+    QWriteLocker lock(&m_lock);
+
+    m_pending.insert(file.absoluteFilePath(), Entry{file.size(), modifiedTime(file), tags});
+}
+
+bool LibraryIndex::save()
+{
+    QMutexLocker saving(&m_saveMutex);
+
+    QHash<QString, Entry> pending;
+    QVector<Record> records;
+    QByteArray strings;
+
+    // lookups go on while the new file is built and written, inserts wait for the copy
+    QReadLocker readLock(&m_lock);
+
+    if(m_pending.isEmpty() || m_fileName.isEmpty()) {
+        return true;
+    }
+
+    pending = m_pending;
+    records.reserve(static_cast<int>(count()) + pending.size());
+
+    const auto addString = [&strings](const QString& string) {
+        const QByteArray bytes = string.toUtf8();
+        const quint32 offset = static_cast<quint32>(strings.size());
+        const quint32 length = static_cast<quint32>(bytes.size());
+
+        strings.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        strings.append(bytes);
+
+        return offset;
+    };
+
+    // keep what is on disk unless it was read again
+    for(quint32 i = 0; i < count(); ++i) {
+        const Record* record = &this->records()[i];
+        const QString path = string(record->path);
+        if(pending.contains(path)) {
+            continue;
+        }
+
+        Record copy = *record;
+        copy.path = addString(path);
+        copy.song = addString(string(record->song));
+        copy.album = addString(string(record->album));
+        copy.artist = addString(string(record->artist));
+        copy.cover = addString(string(record->cover));
+        records.append(copy);
+    }
+
+    readLock.unlock();
+
+    for(auto entry = pending.constBegin(); entry != pending.constEnd(); ++entry) {
+        Record record {};
+        record.hash = pathHash(entry.key());
+        record.size = entry->size;
+        record.modified = entry->modified;
+        record.duration = entry->tags.duration;
+        record.path = addString(entry.key());
+        record.song = addString(entry->tags.song);
+        record.album = addString(entry->tags.album);
+        record.artist = addString(entry->tags.artist);
+        record.cover = addString(entry->tags.coverUrl);
+        records.append(record);
+    }
+
+    std::sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+        return a.hash < b.hash;
+    });
+
+    LibraryIndexHeader header {};
+    std::memcpy(header.magic, index_magic, sizeof(index_magic));
+    header.version = index_version;
+    header.count = static_cast<quint32>(records.size());
+
+    QSaveFile file(m_fileName);
+    bool saved = file.open(QIODevice::WriteOnly)
+            && file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header)
+            && file.write(reinterpret_cast<const char*>(records.constData()), records.size() * sizeof(Record))
+                == static_cast<qint64>(records.size() * sizeof(Record))
+            && file.write(strings) == strings.size();
+
+    // only the swap blocks lookups, the old file can not be replaced while it is mapped on some systems
+    QWriteLocker writeLock(&m_lock);
+    unmap();
+
+    saved = saved && file.commit();
+
+    if(saved) {
+        // entries read again while writing stay pending
+        for(auto entry = pending.constBegin(); entry != pending.constEnd(); ++entry) {
+            auto current = m_pending.find(entry.key());
+            if(current != m_pending.end() && current->size == entry->size && current->modified == entry->modified) {
+                m_pending.erase(current);
+            }
+        }
+    } else {
+        qWarning() << "Library index: could not write" << m_fileName << file.errorString();
+    }
+
+    map();
+
+    return saved;
+}
@@ -0,0 +1,73 @@
+#ifndef LIBRARYINDEX_H
+#define LIBRARYINDEX_H
+
+#include "audiotaginfo.h"
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QString>
+
+class QFileInfo;
+
+//! Tags of every file read so far, kept on disk between sessions.
+//! An entry is valid while the size and modification time of its file
+//! match, so adding a known file is a stat and a lookup instead of a
+//! tag parse.
+//!
+//! The index is one binary file, read through a memory map:
+//! a header, records sorted by a hash of the path for binary search,
+//! then the strings the records point to. New entries are kept in
+//! memory until save() merges them into a new file.
+//! Safe to use from several threads.
+class LibraryIndex
+{
+    struct Record;
+
+    struct Entry {
+        qint64 size;
+        qint64 modified;
+        AudioTagInfo tags;
+    };
+
+    QString m_fileName;
+    QFile m_file;
+    const uchar* m_map;
+    qint64 m_mapSize;
+
+    // not saved yet, keyed by path
+    QHash<QString, Entry> m_pending;
+
+    mutable QReadWriteLock m_lock;
+    // one save at a time, lookups only wait for the file swap
+    QMutex m_saveMutex;
+
+    void map();
+    void unmap();
+    const Record* records() const;
+    quint32 count() const;
+    QString string(quint32 offset) const;
+    const Record* findRecord(const QString& path) const;
+
+public:
+    LibraryIndex();
+    ~LibraryIndex();
+
+    LibraryIndex(const LibraryIndex&) = delete;
+    LibraryIndex& operator=(const LibraryIndex&) = delete;
+
+    //! Map the index file, an invalid or missing file starts an empty index.
+    void open(const QString& fileName);
+
+    //! Tags of the file if it has not changed since they were read.
+    bool find(const QFileInfo& file, AudioTagInfo& tags) const;
+
+    void insert(const QFileInfo& file, const AudioTagInfo& tags);
+
+    //! Write new entries to disk, does nothing if there are none.
+    //! Lookups and inserts go on while the file is written.
+    bool save();
+};
+
+#endif // LIBRARYINDEX_H
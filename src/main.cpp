@@ -6,10 +6,17 @@
 
 #include "applicationcontroller.h"
 #include "visualisationrenderer.h"
+#include "waveformimageprovider.h"
+#include "coverimageprovider.h"
+#include "shadercache.h"
+#include "offlinerenderer.h"
+#include "playlistbenchmark.h"
+#include "playlistsorter.h"
 
 #include "portaudio.h"
 #include "libnyquist/Decoders.h"
 #include <QLoggingCategory>
+#include <QCommandLineParser>
 
 #ifdef NDEBUG
     #define QT_NO_DEBUG
@@ -28,6 +35,11 @@ int main(int argc, char *argv[]) try
 #endif
 
     qmlRegisterType<Visualisation>("VisRenderOpenGL", 1, 0, "Visualisation");
+    qmlRegisterUncreatableMetaObject(PlaylistSorter::staticMetaObject, "Playlist", 1, 0,
+                                     "PlaylistSorter", "Only sort keys are exposed");
+
+    // shaders are compiled in a context shared with the scene graph
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
 
     // init GUI
     QGuiApplication app(argc, argv);
@@ -38,6 +50,58 @@ int main(int argc, char *argv[]) try
     QCoreApplication::setOrganizationName("Alexander Sh.");
     QCoreApplication::setApplicationName("Tunage");
 
+    // headless rendering to image sequences
+    QCommandLineParser parser;
+    parser.addHelpOption();
+
+    QCommandLineOption renderOption("render", "Render <audio> offline instead of opening the window. "
+                                              "Without a display run with -platform offscreen.", "audio");
+    QCommandLineOption shaderOption("shader", "Shader to render offline.", "glsl", "shaders/waveform.glsl");
+    QCommandLineOption sizeOption("size", "Offline frame size.", "WxH", "1280x720");
+    QCommandLineOption fpsOption("fps", "Offline frame rate.", "fps", "60");
+    QCommandLineOption outputOption("output", "Directory for png frames, file or - for stdout for raw RGBA frames.",
+                                    "path", "frames");
+    QCommandLineOption formatOption("format", "png, raw or none to only benchmark.", "format", "png");
+    QCommandLineOption framesOption("frames", "Stop after this many frames.", "count", "0");
+    QCommandLineOption benchmarkOption("benchmark", "Time playlist operations instead of opening the window, one of "
+                                                    + PlaylistBenchmark::names().join(", ") + " or all.", "name");
+    QCommandLineOption entriesOption("entries", "Playlist entries to benchmark, 0 for the default of each benchmark.",
+                                     "count", "0");
+    parser.addOptions({renderOption, shaderOption, sizeOption, fpsOption, outputOption, formatOption, framesOption,
+                       benchmarkOption, entriesOption});
+    parser.process(app);
+
+    if(parser.isSet(benchmarkOption)) {
+        return PlaylistBenchmark::run(parser.value(benchmarkOption), parser.value(entriesOption).toInt());
+    }
+
+    if(parser.isSet(renderOption)) {
+        const QStringList size = parser.value(sizeOption).split('x');
+        const QString format = parser.value(formatOption);
+
+        OfflineRenderer::Options options;
+        options.audioFile = parser.value(renderOption);
+        options.shader = parser.value(shaderOption);
+        options.size = size.size() == 2 ? QSize(size[0].toInt(), size[1].toInt()) : QSize();
+        options.fps = parser.value(fpsOption).toInt();
+        options.output = parser.value(outputOption);
+        options.format = format == "raw" ? OfflineRenderer::Format::Raw
+                       : format == "none" ? OfflineRenderer::Format::None
+                       : OfflineRenderer::Format::Png;
+        options.maxFrames = parser.value(framesOption).toInt();
+
+        if(options.size.isEmpty() || options.fps <= 0) {
+            qWarning() << "Invalid size or frame rate";
+            return 1;
+        }
+
+        return OfflineRenderer(options).run();
+    }
+
+    // compile visualisation shaders in the background
+    ShaderCache shaderCache("shaders");
+    shaderCache.precompile();
+
     // init sound engine
     ApplicationController appController;
 
@@ -45,6 +109,8 @@ int main(int argc, char *argv[]) try
     QQmlApplicationEngine engine;
     QQmlContext *context = engine.rootContext();
     context->setContextProperty("appController", &appController);
+    engine.addImageProvider("waveform", new WaveformImageProvider(appController.soundEngine()));
+    engine.addImageProvider("cover", new CoverImageProvider());
 
     engine.load(QUrl(QStringLiteral("qrc:/main.qml")));
     if (engine.rootObjects().isEmpty())
@@ -62,8 +128,12 @@ int main(int argc, char *argv[]) try
     }
     if(visualizer) {
         qDebug() << "buffers set";
-        visualizer->setSpectrumBuffer(appController.spectrumBuffer());
-        visualizer->setWaveformBuffer(appController.waveformBuffer());
+        visualizer->setFrameBuffer(appController.frameBuffer());
+        visualizer->setShaderCache(&shaderCache);
+        QObject::connect(&appController, &ApplicationController::spectrumChanged,
+                         visualizer, &Visualisation::frameReady);
+        QObject::connect(&appController, &ApplicationController::loadingFileFinished,
+                         visualizer, &Visualisation::trackChanged);
     }
 
     return app.exec();
@@ -5,6 +5,7 @@ import QtQuick.Dialogs 1.2
 import QtQuick.Layouts 1.3
 import QtQuick.Controls.Material 2.2
 import VisRenderOpenGL 1.0
+import Playlist 1.0
 
 ApplicationWindow {
     id: window
@@ -131,6 +132,27 @@ ApplicationWindow {
             onClicked: shaderFileDialog.open()
         }
 
+        MenuItem {
+            text: qsTr("Next shader")
+            onClicked: visualizer.nextShader()
+        }
+
+        MenuItem {
+            text: qsTr("Rotate shaders with tracks")
+            checkable: true
+            onCheckedChanged: visualizer.rotateOnTrackChange = checked
+        }
+
+        MenuItem {
+            text: qsTr("Open playlist...")
+            onClicked: playlistOpenDialog.open()
+        }
+
+        MenuItem {
+            text: qsTr("Save playlist...")
+            onClicked: playlistSaveDialog.open()
+        }
+
         MenuItem {
             text: qsTr("Fullscreen")
             onClicked: {
@@ -192,10 +214,53 @@ ApplicationWindow {
                         text: qsTr("Load")
                         onClicked: musicFileDialog.open()
                     }
+                    ToolButton {
+                        text: qsTr("Add folder")
+                        onClicked: folderDialog.open()
+                    }
                     ToolButton {
                         text: qsTr("Clear")
                         onClicked: appController.removeAllFiles()
                     }
+                    ToolButton {
+                        text: qsTr("Sort")
+                        onClicked: sortMenu.popup()
+
+                        Menu {
+                            id: sortMenu
+                            property bool descending: false
+
+                            MenuItem {
+                                text: qsTr("Artist")
+                                onClicked: appController.sortPlaylist(PlaylistSorter.SortByArtist, sortMenu.descending)
+                            }
+                            MenuItem {
+                                text: qsTr("Album")
+                                onClicked: appController.sortPlaylist(PlaylistSorter.SortByAlbum, sortMenu.descending)
+                            }
+                            MenuItem {
+                                text: qsTr("Title")
+                                onClicked: appController.sortPlaylist(PlaylistSorter.SortByTitle, sortMenu.descending)
+                            }
+                            MenuItem {
+                                text: qsTr("Duration")
+                                onClicked: appController.sortPlaylist(PlaylistSorter.SortByDuration, sortMenu.descending)
+                            }
+                            MenuItem {
+                                text: qsTr("Path")
+                                onClicked: appController.sortPlaylist(PlaylistSorter.SortByPath, sortMenu.descending)
+                            }
+                            MenuItem {
+                                text: qsTr("Date added")
+                                onClicked: appController.sortPlaylist(PlaylistSorter.SortByAdded, sortMenu.descending)
+                            }
+                            MenuItem {
+                                text: qsTr("Descending")
+                                checkable: true
+                                onCheckedChanged: sortMenu.descending = checked
+                            }
+                        }
+                    }
                     ToolButton {
                         icon.source: "more_24px"
                         onClicked: contextMenu.popup()
@@ -203,6 +268,26 @@ ApplicationWindow {
                 }
             }
 
+            TextField {
+                id: searchField
+                Layout.fillWidth: true
+                Layout.leftMargin: 5
+                Layout.rightMargin: 5
+                placeholderText: qsTr("Search")
+                selectByMouse: true
+                onTextChanged: appController.playlistSearch.query = text
+                Keys.onEscapePressed: clear()
+            }
+
+            Label {
+                Layout.leftMargin: 5
+                Layout.rightMargin: 5
+                visible: appController.playlistSearch.truncated
+                text: qsTr("Showing the first %1 of %2 matches, keep typing to narrow them")
+                      .arg(playlist.count).arg(appController.playlistSearch.totalMatches)
+                font.pixelSize: 12
+            }
+
             ListView {
                 id: playlist
                 Layout.fillWidth: true
@@ -216,7 +301,7 @@ ApplicationWindow {
                     onCurrentIndexChanged: playlist.currentIndex = index
                 }
 
-                model: appController.playlist
+                model: appController.playlistSearch
                 delegate: Item {
                     id: item
                     width: parent.width
@@ -252,19 +337,19 @@ ApplicationWindow {
                         onPressed: {
                             if (mouse.button === Qt.LeftButton) {
                                 playlist.currentIndex = index
-                                appController.setCurrentItem(index)
+                                appController.setCurrentItem(sourceRow)
                             }
                         }
 
                         onReleased: {
                             if (mouse.button === Qt.RightButton) {
-                                appController.removeItem(index)
+                                appController.removeItem(sourceRow)
                             }
                         }
 
                         onDoubleClicked: {
                             if (mouse.button === Qt.LeftButton) {
-                                appController.setCurrentItem(index)
+                                appController.setCurrentItem(sourceRow)
                                 appController.play(true)
                             }
                         }
@@ -323,6 +408,41 @@ ApplicationWindow {
         Component.onCompleted: visible = false
     }
 
+    FileDialog {
+        id: folderDialog
+        title: qsTr("Please choose a music folder")
+        folder: shortcuts.music
+        selectFolder: true
+        onAccepted: {
+            appController.addFolder(fileUrl)
+        }
+        Component.onCompleted: visible = false
+    }
+
+    FileDialog {
+        id: playlistOpenDialog
+        title: qsTr("Please choose a playlist")
+        folder: shortcuts.music
+        nameFilters: ["Playlists (*.m3u *.m3u8 *.pls *.xspf)", "All Files (*)"]
+        selectMultiple: false
+        onAccepted: {
+            appController.loadPlaylist(fileUrl)
+        }
+        Component.onCompleted: visible = false
+    }
+
+    FileDialog {
+        id: playlistSaveDialog
+        title: qsTr("Save the playlist as")
+        folder: shortcuts.music
+        nameFilters: ["M3U8 (*.m3u8)", "PLS (*.pls)", "XSPF (*.xspf)"]
+        selectExisting: false
+        onAccepted: {
+            appController.savePlaylist(fileUrl)
+        }
+        Component.onCompleted: visible = false
+    }
+
     Drawer {
         id: buttonDrawer
         height: 96
@@ -343,6 +463,7 @@ ApplicationWindow {
             mediaName: appController.song
             mediaArtistName: appController.artist
             mediaCoverUrl: appController.coverUrl
+            mediaWaveformUrl: appController.waveformUrl
 
             playing: appController.isPlaying
 
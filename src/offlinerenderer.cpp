@@ -0,0 +1,170 @@
+#include "offlinerenderer.h"
+#include "visualisationrenderer.h"
+
+#include "audio_engine/decoder.h"
+#include "audio_engine/spectrumanalyzer.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QSurfaceFormat>
+#include <QThread>
+#include <QUrl>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// give up on the tempo estimate after this long
+constexpr int spectrogram_timeout_ms = 60000;
+
+OfflineRenderer::OfflineRenderer(const Options &options)
+    : m_options(options)
+{
+}
+
+int OfflineRenderer::run()
+{
+    // decode
+    audioengine::Decoder decoder;
+    if(!decoder.decode_load_single(m_options.audioFile.toStdString())) {
+        qWarning() << "Offline: could not decode" << m_options.audioFile;
+        return 1;
+    }
+
+    const std::shared_ptr<nqr::AudioData> audio = decoder.current_audio();
+    const int channels = std::max(audio->channelCount, 1);
+    const int64_t trackFrames = audio->samples.size() / channels;
+
+    // estimated here rather than on the pool, so every run sees the same tempo
+    float bpm = 0;
+    QElapsedTimer waited;
+    waited.start();
+    auto spectrogram = decoder.current_spectrogram();
+    while(spectrogram && !spectrogram->ready() && waited.elapsed() < spectrogram_timeout_ms) {
+        QThread::msleep(10);
+    }
+    if(spectrogram && spectrogram->ready()) {
+        bpm = audioengine::estimate_track_bpm(*spectrogram);
+    }
+
+    audioengine::SpectrumAnalyzer analyzer(nullptr);
+    analyzer.set_sample_rate(audio->sampleRate);
+    analyzer.set_tempo_source([bpm]() { return bpm; });
+    analyzer.reset();
+
+    // offscreen GL
+    QOffscreenSurface surface;
+    surface.setFormat(QSurfaceFormat::defaultFormat());
+    surface.create();
+
+    QOpenGLContext context;
+    context.setFormat(surface.format());
+    if(!context.create() || !context.makeCurrent(&surface)) {
+        qWarning() << "Offline: could not create an OpenGL context";
+        return 1;
+    }
+
+    QFile rawOutput(m_options.output);
+    if(m_options.format == Format::Raw) {
+        const bool opened = m_options.output == "-"
+                ? rawOutput.open(stdout, QIODevice::WriteOnly)
+                : rawOutput.open(QIODevice::WriteOnly);
+        if(!opened) {
+            qWarning() << "Offline: could not open" << m_options.output;
+            return 1;
+        }
+    } else if(m_options.format == Format::Png && !QDir().mkpath(m_options.output)) {
+        qWarning() << "Offline: could not create" << m_options.output;
+        return 1;
+    }
+
+    int frames = static_cast<int>(trackFrames * m_options.fps / std::max(audio->sampleRate, 1));
+    if(m_options.maxFrames > 0) {
+        frames = std::min(frames, m_options.maxFrames);
+    }
+
+    qInfo() << "Offline:" << frames << "frames of" << m_options.size << "at" << m_options.fps << "fps,"
+            << "tempo" << bpm;
+
+    std::vector<qint64> renderTimes;
+    renderTimes.reserve(frames);
+
+    QElapsedTimer total;
+    total.start();
+
+    {
+        // GL resources of the renderer go before the context
+        QOpenGLFramebufferObject output(m_options.size);
+        VisualisationRenderer renderer;
+        renderer.setFrameBuffer(analyzer.frames_out);
+        renderer.setShaderPath(QUrl::fromLocalFile(m_options.shader));
+
+        const int readFrames = analyzer.read_size() / audioengine::stereo;
+        std::vector<float> window(analyzer.read_size());
+
+        QElapsedTimer timer;
+        for(int frame = 0; frame < frames; ++frame) {
+            // the read that ends at this video frame, as stereo
+            const int64_t end = static_cast<int64_t>(frame + 1) * audio->sampleRate / m_options.fps;
+            for(int i = 0; i < readFrames; ++i) {
+                const int64_t position = end - readFrames + i;
+                const float* in = position >= 0 && position < trackFrames
+                        ? &audio->samples[position * channels]
+                        : nullptr;
+
+                window[i * audioengine::stereo] = in ? in[0] : 0.f;
+                window[i * audioengine::stereo + 1] = in ? in[std::min(1, channels - 1)] : 0.f;
+            }
+
+            analyzer.process_frame(window.data(), 1. / m_options.fps);
+
+            timer.start();
+            renderer.renderOffline(&output, frame * 1000LL / m_options.fps);
+            context.functions()->glFinish();
+            renderTimes.push_back(timer.nsecsElapsed());
+
+            if(m_options.format == Format::None) {
+                continue;
+            }
+
+            const QImage image = output.toImage().convertToFormat(QImage::Format_RGBA8888);
+            if(m_options.format == Format::Raw) {
+                rawOutput.write(reinterpret_cast<const char*>(image.constBits()), image.sizeInBytes());
+            } else {
+                image.save(QDir(m_options.output).filePath(QString("frame_%1.png").arg(frame, 6, 10, QChar('0'))));
+            }
+        }
+    }
+
+    context.doneCurrent();
+
+    if(renderTimes.empty()) {
+        qWarning() << "Offline: nothing to render";
+        return 1;
+    }
+
+    // benchmark summary
+    std::sort(renderTimes.begin(), renderTimes.end());
+    double sum = 0;
+    for(qint64 time : renderTimes) {
+        sum += time;
+    }
+
+    const double mean = sum / renderTimes.size() / 1e6;
+    const double median = renderTimes[renderTimes.size() / 2] / 1e6;
+    const double p99 = renderTimes[std::min(renderTimes.size() - 1, renderTimes.size() * 99 / 100)] / 1e6;
+    const double seconds = total.elapsed() / 1000.;
+
+    qInfo() << "Offline: rendered" << renderTimes.size() << "frames in" << seconds << "s,"
+            << "render mean" << mean << "ms, median" << median << "ms, 99th percentile" << p99 << "ms,"
+            << double(renderTimes.size()) / m_options.fps / std::max(seconds, 1e-3) << "x realtime";
+
+    return 0;
+}
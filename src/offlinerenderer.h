@@ -0,0 +1,43 @@
+#ifndef OFFLINERENDERER_H
+#define OFFLINERENDERER_H
+
+#include <QSize>
+#include <QString>
+
+//! Renders a visualisation of an audio file to an image sequence without a window.
+//! Analysis is stepped once per video frame with a fixed time step, so the
+//! same file, shader, size and frame rate always give the same frames.
+//! Frames are written as PNG files, or as raw RGBA to a file or stdout
+//! for piping into an encoder. Renders as fast as the GPU allows and prints
+//! frame time statistics, which makes it a reproducible shader benchmark.
+class OfflineRenderer
+{
+public:
+    enum class Format {
+        Png,
+        Raw,
+        None
+    };
+
+    struct Options {
+        QString audioFile;
+        QString shader;
+        QSize size;
+        int fps;
+        //! Directory for PNG frames, file for raw frames, "-" for stdout.
+        QString output;
+        Format format;
+        //! Stop after this many frames, 0 renders the whole track.
+        int maxFrames;
+    };
+
+    explicit OfflineRenderer(const Options& options);
+
+    //! Returns the process exit code.
+    int run();
+
+private:
+    Options m_options;
+};
+
+#endif // OFFLINERENDERER_H
@@ -5,6 +5,8 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QSettings>
+#include <QDir>
+#include <QStandardPaths>
 
 #include "audiotaginfo.h"
 
@@ -24,6 +26,16 @@ PlaybackEngine::PlaybackEngine()
         emit spectrumDataChanged();
     });
 
+    m_spectrum.set_precomputed_source([this]() {
+        return m_decoder.current_spectrogram();
+    }, [this]() {
+        return m_decoder.position_samples();
+    });
+
+    m_spectrum.set_tempo_source([this]() {
+        return m_decoder.current_bpm();
+    });
+
     m_playback.set_playback_buffer(m_decoder.sample_buffer());
 
     m_decoder.set_position_callback([this]() {
@@ -35,6 +47,23 @@ PlaybackEngine::PlaybackEngine()
         emit fileEnded();
     });
 
+    m_decoder.set_peaks_ready_callback([this]() {
+        // the spectrogram is ready along with the overview
+        m_spectrum.wake();
+        emit waveformOverviewChanged();
+    });
+
+    // the analyzer sleeps while there is nothing new to analyse
+    m_decoder.set_visualizer_callback([this]() {
+        m_spectrum.wake();
+    });
+
+    // waveform overviews and tempo are cached between sessions
+    QString analysisCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/analysis";
+    if(QDir().mkpath(analysisCacheDir)) {
+        m_decoder.set_analysis_cache_dir(analysisCacheDir.toStdString());
+    }
+
     m_decoder.start_thread();
     m_spectrum.start_thread();
 
@@ -116,6 +145,13 @@ bool PlaybackEngine::loadFile(const QString& localFilename)
 
     playbackStreamRestart();
 
+    if(m_isReady) {
+        m_spectrum.set_sample_rate(m_decoder.sample_rate());
+        m_spectrum.wake();
+    }
+
+    emit waveformOverviewChanged();
+
     return m_isReady;
 }
 
@@ -141,6 +177,13 @@ bool PlaybackEngine::loadFromCache(const QString &localFilename)
 
     playbackStreamRestart();
 
+    if(m_isReady) {
+        m_spectrum.set_sample_rate(m_decoder.sample_rate());
+        m_spectrum.wake();
+    }
+
+    emit waveformOverviewChanged();
+
     return m_isReady;
 }
 
@@ -182,6 +225,7 @@ void PlaybackEngine::setPosition(qint64 pos)
     Q_ASSERT(pos >= 0);
 
     m_decoder.set_position_miliseconds(pos);
+    m_spectrum.wake();
     emit positionChanged();
 }
 
@@ -223,13 +267,15 @@ bool PlaybackEngine::isPlaying() const
     return m_decoder.playing();
 }
 
-std::shared_ptr<RingBufferT<double>> PlaybackEngine::getSpectrumDataBuffer()
+std::shared_ptr<audioengine::AnalysisFrameBuffer> PlaybackEngine::getAnalysisFrameBuffer()
 {
-    return m_spectrum.fft_avg_out;
+    return m_spectrum.frames_out;
 }
-std::shared_ptr<RingBufferT<double>> PlaybackEngine::getWaveformDataBuffer()
+
+std::shared_ptr<audioengine::PeakPyramid> PlaybackEngine::waveformOverview() const
 {
-    return m_spectrum.waveform_avg_out;
+    auto peaks = m_decoder.current_peaks();
+    return peaks && peaks->ready() ? peaks : nullptr;
 }
 
 bool PlaybackEngine::isMuted() const
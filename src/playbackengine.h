@@ -77,16 +77,19 @@ public:
     bool isPlaying() const;
 
     /**
-     * @brief getSpectrumDataBuffer
-     * @return ring buffer with FFT data.
+     * @brief getAnalysisFrameBuffer
+     * @return triple buffer with the newest analysis frame:
+     * spectrum and waveform texture and frame features.
      */
-    std::shared_ptr<RingBufferT<double>> getSpectrumDataBuffer();
+    std::shared_ptr<audioengine::AnalysisFrameBuffer> getAnalysisFrameBuffer();
 
     /**
-     * @brief getSpectrumDataBuffer
-     * @return ring buffer with a waveform.
+     * @brief waveformOverview
+     * @return peak pyramid of the current file or nullptr if it is not ready.
+     *
+     * Safe to call from any thread.
      */
-    std::shared_ptr<RingBufferT<double>> getWaveformDataBuffer();
+    std::shared_ptr<audioengine::PeakPyramid> waveformOverview() const;
 
     /**
      * @brief currentFile
@@ -192,6 +195,7 @@ signals:
     void fileEnded();
 
     void spectrumDataChanged();
+    void waveformOverviewChanged();
 
     void error(const QString& what);
 };
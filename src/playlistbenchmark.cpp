@@ -0,0 +1,235 @@
+#include "playlistbenchmark.h"
+#include "playlistfile.h"
+#include "playlistitemmodel.h"
+#include "playlistsearchmodel.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QPair>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// runs of every benchmark, the median is reported
+constexpr int benchmark_runs = 5;
+
+constexpr int tracks_per_album = 12;
+constexpr int albums_per_artist = 8;
+
+// the median and fastest of several runs, in milliseconds
+static void report(const QString& name, int entries, const std::function<qint64()>& run)
+{
+    std::vector<qint64> times;
+    for(int i = 0; i < benchmark_runs; ++i) {
+        times.push_back(run());
+    }
+
+    std::sort(times.begin(), times.end());
+
+    qInfo().noquote() << "Benchmark:" << name << entries << "entries,"
+                      << "median" << times[times.size() / 2] / 1e6 << "ms,"
+                      << "fastest" << times.front() / 1e6 << "ms";
+}
+
+QStringList PlaylistBenchmark::names()
+{
+    return {"insert", "search", "sort", "read"};
+}
+
+int PlaylistBenchmark::run(const QString &name, int entries)
+{
+    if(name != "all" && !names().contains(name)) {
+        qWarning() << "Benchmark: unknown benchmark" << name << "use one of" << names() << "or all";
+        return 1;
+    }
+
+    if(name == "all" || name == "insert") {
+        insert(entries > 0 ? entries : 100000);
+    }
+
+    if(name == "all" || name == "search") {
+        search(entries > 0 ? entries : 1000000);
+    }
+
+    if(name == "all" || name == "sort") {
+        sort(entries > 0 ? entries : 1000000);
+    }
+
+    if(name == "all" || name == "read") {
+        read(entries > 0 ? entries : 100000);
+    }
+
+    return 0;
+}
+
+QStringList PlaylistBenchmark::libraryPaths(int entries)
+{
+    QStringList paths;
+    paths.reserve(entries);
+
+    for(int i = 0; i < entries; ++i) {
+        const int album = i / tracks_per_album;
+        const int artist = album / albums_per_artist;
+
+        paths << QString("/tunage-benchmark/Artist %1/Album %2/%3 Track %4.flac")
+                 .arg(artist).arg(album).arg(i % tracks_per_album + 1, 2, 10, QChar('0')).arg(i);
+    }
+
+    return paths;
+}
+
+// what a QList<AudioTagInfo> holds for an entry, empty strings share one null
+static qint64 tagInfoBytes(const AudioTagInfo& item)
+{
+    qint64 bytes = static_cast<qint64>(sizeof(void*) + sizeof(AudioTagInfo));
+    for(const QString* string : { &item.song, &item.album, &item.artist, &item.coverUrl, &item.fileName, &item.path }) {
+        if(!string->isEmpty()) {
+            bytes += 24 + (string->size() + 1) * 2;
+        }
+    }
+
+    return bytes;
+}
+
+void PlaylistBenchmark::insert(int entries)
+{
+    const QStringList paths = libraryPaths(entries);
+
+    // placeholders and the queued tag scan, what the GUI thread does on an import
+    report("insert", entries, [&paths]() {
+        PlaylistItemModel model;
+
+        QElapsedTimer timer;
+        timer.start();
+        model.addFilePaths(paths);
+        const qint64 time = timer.nsecsElapsed();
+
+        model.reset();
+        return time;
+    });
+
+    // once tags are read, against a list of the entries
+    const QList<AudioTagInfo> items = libraryItems(entries);
+    PlaylistItemModel model;
+    model.addPlaylistItems(items);
+
+    qint64 listBytes = 0;
+    for(const AudioTagInfo& item : items) {
+        listBytes += tagInfoBytes(item);
+    }
+
+    const double storeBytes = static_cast<double>(model.items().memoryUsage());
+    qInfo().noquote() << "Benchmark: memory" << entries << "entries,"
+                      << storeBytes / entries << "bytes per entry, a list of tags takes"
+                      << static_cast<double>(listBytes) / entries << "bytes,"
+                      << listBytes / storeBytes << "times as much";
+}
+
+QList<AudioTagInfo> PlaylistBenchmark::libraryItems(int entries)
+{
+    const QStringList paths = libraryPaths(entries);
+
+    QList<AudioTagInfo> items;
+    items.reserve(entries);
+
+    for(int i = 0; i < entries; ++i) {
+        const int album = i / tracks_per_album;
+
+        AudioTagInfo item = AudioTagInfo::placeholder(paths.at(i));
+        item.song = QString("Track %1").arg(i);
+        item.album = QString("Album %1").arg(album);
+        item.artist = QString("Artist %1").arg(album / albums_per_artist);
+        item.duration = 180000 + i % 120000;
+
+        items << item;
+    }
+
+    return items;
+}
+
+void PlaylistBenchmark::search(int entries)
+{
+    PlaylistItemModel model;
+    model.addPlaylistItems(libraryItems(entries));
+
+    PlaylistSearchModel search(&model);
+
+    // a keystroke each, from most of the playlist to a single row
+    const QStringList queries = {"t", "tr", "track", "artist 1", "album 12 track", QString("track %1").arg(entries / 2)};
+
+    for(const QString& query : queries) {
+        report(QString("search \"%1\"").arg(query), entries, [&search, &query]() {
+            search.setQuery(QString());
+
+            QElapsedTimer timer;
+            timer.start();
+            search.setQuery(query);
+
+            return timer.nsecsElapsed();
+        });
+    }
+}
+
+void PlaylistBenchmark::sort(int entries)
+{
+    PlaylistItemModel model;
+    model.addPlaylistItems(libraryItems(entries));
+
+    // interned strings, collation keys of every entry, and both
+    const QList<QPair<QString, PlaylistSorter::SortKey>> keys = {
+        {"artist", PlaylistSorter::SortByArtist},
+        {"title", PlaylistSorter::SortByTitle},
+        {"path", PlaylistSorter::SortByPath}
+    };
+
+    for(const auto& key : keys) {
+        report("sort by " + key.first, entries, [&model, &key]() {
+            model.sortBy(PlaylistSorter::SortByAdded, Qt::AscendingOrder);
+
+            QElapsedTimer timer;
+            timer.start();
+            model.sortBy(key.second, Qt::DescendingOrder);
+
+            return timer.nsecsElapsed();
+        });
+    }
+}
+
+void PlaylistBenchmark::read(int entries)
+{
+    QTemporaryDir directory;
+    if(!directory.isValid()) {
+        qWarning() << "Benchmark: could not create a directory for playlists";
+        return;
+    }
+
+    PlaylistItemModel model;
+    model.addPlaylistItems(libraryItems(entries));
+
+    QVector<int> order;
+    order.reserve(entries);
+    for(int row = 0; row < entries; ++row) {
+        order << model.itemIndex(row);
+    }
+
+    // only the parse, adding the paths is what insert measures
+    for(const QString& suffix : {"m3u8", "pls", "xspf"}) {
+        const QString fileName = directory.filePath("benchmark." + suffix);
+        if(!PlaylistFile::write(fileName, model.items(), order)) {
+            qWarning() << "Benchmark: could not write" << fileName;
+            continue;
+        }
+
+        report("read " + suffix, entries, [&fileName]() {
+            QStringList paths;
+
+            QElapsedTimer timer;
+            timer.start();
+            PlaylistFile::read(fileName, paths);
+
+            return timer.nsecsElapsed();
+        });
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef PLAYLISTBENCHMARK_H
+#define PLAYLISTBENCHMARK_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "audiotaginfo.h"
+
+//! Times playlist operations on generated entries without a window and prints
+//! the GUI thread time of each run. Paths look like a music library,
+//! artists with albums of tracks, but the files do not exist, so tags are
+//! never read and the library index is left alone. Playlists read are
+//! written to a temporary directory first.
+class PlaylistBenchmark
+{
+public:
+    //! Benchmark names, "all" runs every one of them.
+    static QStringList names();
+
+    //! Returns the process exit code. With 0 entries each benchmark uses its own default.
+    static int run(const QString& name, int entries);
+
+private:
+    static QStringList libraryPaths(int entries);
+    //! The same entries with their tags read.
+    static QList<AudioTagInfo> libraryItems(int entries);
+
+    static void insert(int entries);
+    static void search(int entries);
+    static void sort(int entries);
+    static void read(int entries);
+};
+
+#endif // PLAYLISTBENCHMARK_H
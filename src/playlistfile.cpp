@@ -0,0 +1,471 @@
+#include "playlistfile.h"
+#include "playliststore.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QPair>
+#include <QSaveFile>
+#include <QUrl>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+#include <algorithm>
+#include <cstring>
+
+// text playlists are written out in pieces of about this size
+constexpr int write_chunk_size = 1 << 20;
+
+namespace {
+
+// entries of a playlist usually share a few directories,
+// each one is made absolute and cleaned once
+class PathResolver
+{
+    QDir m_base;
+    QHash<QString, QString> m_directories;
+
+public:
+    explicit PathResolver(const QString& playlist)
+        : m_base(QFileInfo(playlist).absoluteDir())
+    {
+    }
+
+    QString resolve(QString entry)
+    {
+        entry.replace('\\', '/');
+
+        // with its trailing '/', so "" is the playlist directory and "/" the root
+        const int separator = entry.lastIndexOf('/');
+        const QString directory = entry.left(separator + 1);
+
+        auto it = m_directories.constFind(directory);
+        if(it == m_directories.constEnd()) {
+            QString absolute = QDir::cleanPath(m_base.absoluteFilePath(directory));
+            if(!absolute.endsWith('/')) {
+                absolute += '/';
+            }
+
+            it = m_directories.insert(directory, absolute);
+        }
+
+        return *it + entry.mid(separator + 1);
+    }
+};
+
+// paths relative to the playlist, one directory at a time like PathResolver
+class PathWriter
+{
+    QDir m_base;
+    bool m_encode;
+    QVector<QString> m_directories;
+    QVector<bool> m_known;
+
+public:
+    //! Percent-encoded URIs if 'encode' is set, plain paths otherwise.
+    PathWriter(const QString& playlist, const PlaylistStore& store, bool encode)
+        : m_base(QFileInfo(playlist).absoluteDir()),
+          m_encode(encode),
+          m_directories(store.stringCount()),
+          m_known(store.stringCount(), false)
+    {
+    }
+
+    QString path(const PlaylistStore& store, int item)
+    {
+        const quint32 id = store.directoryId(item);
+        if(!m_known.at(id)) {
+            // absolute if there is no relative path, e.g. on another drive
+            QString directory = m_base.relativeFilePath(store.string(id));
+            if(directory == ".") {
+                directory.clear();
+            }
+            if(!directory.isEmpty()) {
+                directory += '/';
+            }
+
+            if(m_encode) {
+                directory = QDir::isAbsolutePath(directory)
+                        ? QUrl::fromLocalFile(directory).toString(QUrl::FullyEncoded)
+                        : QString::fromUtf8(QUrl::toPercentEncoding(directory, "/"));
+            }
+
+            m_directories[id] = directory;
+            m_known[id] = true;
+        }
+
+        const QString fileName = store.fileName(item);
+        return m_directories.at(id) + (m_encode ? QString::fromUtf8(QUrl::toPercentEncoding(fileName)) : fileName);
+    }
+};
+
+// calls function(line, length) for every line that is not blank, without the line break
+template <typename Function>
+void forEachLine(const char* data, qint64 size, Function function)
+{
+    const char* end = data + size;
+
+    // UTF-8 byte order mark
+    if(size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        data += 3;
+    }
+
+    while(data < end) {
+        const char* next = static_cast<const char*>(std::memchr(data, '\n', end - data));
+        const char* first = data;
+        const char* last = next ? next : end;
+
+        // '\r' of Windows line breaks and surrounding blanks
+        while(first < last && (*first == ' ' || *first == '\t')) {
+            ++first;
+        }
+        while(last > first && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r')) {
+            --last;
+        }
+
+        if(first < last) {
+            function(first, static_cast<int>(last - first));
+        }
+
+        data = next ? next + 1 : end;
+    }
+}
+
+// whether the bytes are valid UTF-8, a byte order mark included
+bool isUtf8(const char* data, qint64 size)
+{
+    const auto* byte = reinterpret_cast<const unsigned char*>(data);
+    const auto* end = byte + size;
+
+    while(byte < end) {
+        if(*byte < 0x80) {
+            ++byte;
+            continue;
+        }
+
+        int continuation;
+        if(*byte >= 0xC2 && *byte <= 0xDF) {
+            continuation = 1;
+        } else if(*byte >= 0xE0 && *byte <= 0xEF) {
+            continuation = 2;
+        } else if(*byte >= 0xF0 && *byte <= 0xF4) {
+            continuation = 3;
+        } else {
+            return false;
+        }
+
+        if(end - byte <= continuation) {
+            return false;
+        }
+        for(int i = 1; i <= continuation; ++i) {
+            if((byte[i] & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+
+        byte += continuation + 1;
+    }
+
+    return true;
+}
+
+// local path of an entry, empty for remote ones
+QString localEntry(const QString& entry, PathResolver& resolver)
+{
+    if(entry.contains("://")) {
+        const QUrl url(entry);
+        return url.isLocalFile() ? url.toLocalFile() : QString();
+    }
+
+    return resolver.resolve(entry);
+}
+
+void readM3u(const char* data, qint64 size, bool utf8, PathResolver& resolver, QStringList& paths)
+{
+    forEachLine(data, size, [&](const char* line, int length) {
+        // #EXTM3U, #EXTINF and other directives, the tags are read from the files
+        if(line[0] == '#') {
+            return;
+        }
+
+        const QString entry = utf8 ? QString::fromUtf8(line, length) : QString::fromLocal8Bit(line, length);
+        const QString path = localEntry(entry, resolver);
+        if(!path.isEmpty()) {
+            paths << path;
+        }
+    });
+}
+
+void readPls(const char* data, qint64 size, PathResolver& resolver, QStringList& paths)
+{
+    QVector<QPair<int, QString>> entries;
+
+    forEachLine(data, size, [&](const char* line, int length) {
+        // FileN=path, the other keys hold tags
+        if(length < 6 || qstrnicmp(line, "file", 4) != 0) {
+            return;
+        }
+
+        const char* equals = static_cast<const char*>(std::memchr(line, '=', length));
+        if(!equals) {
+            return;
+        }
+
+        bool isNumber = false;
+        const int number = QByteArray(line + 4, static_cast<int>(equals - line - 4)).trimmed().toInt(&isNumber);
+        if(!isNumber) {
+            return;
+        }
+
+        const QString entry = QString::fromUtf8(equals + 1, static_cast<int>(line + length - equals - 1)).trimmed();
+        const QString path = localEntry(entry, resolver);
+        if(!path.isEmpty()) {
+            entries.append(qMakePair(number, path));
+        }
+    });
+
+    // numbered, usually but not always in order
+    std::stable_sort(entries.begin(), entries.end(), [](const QPair<int, QString>& a, const QPair<int, QString>& b) {
+        return a.first < b.first;
+    });
+
+    paths.reserve(paths.size() + entries.size());
+    for(const auto& entry : entries) {
+        paths << entry.second;
+    }
+}
+
+bool readXspf(const char* data, qint64 size, PathResolver& resolver, QStringList& paths)
+{
+    // reads the mapped file in place
+    QXmlStreamReader xml(QByteArray::fromRawData(data, static_cast<int>(size)));
+
+    bool inTrack = false;
+    bool located = false;
+
+    while(!xml.atEnd()) {
+        const QXmlStreamReader::TokenType token = xml.readNext();
+
+        if(token == QXmlStreamReader::StartElement) {
+            if(xml.name() == QLatin1String("track")) {
+                inTrack = true;
+                located = false;
+            } else if(inTrack && !located && xml.name() == QLatin1String("location")) {
+                // further locations of a track are alternatives
+                located = true;
+
+                const QUrl url(xml.readElementText().trimmed());
+                QString path;
+                if(url.isLocalFile()) {
+                    path = url.toLocalFile();
+                } else if(url.isRelative()) {
+                    path = resolver.resolve(url.path());
+                }
+
+                if(!path.isEmpty()) {
+                    paths << path;
+                }
+            }
+        } else if(token == QXmlStreamReader::EndElement && xml.name() == QLatin1String("track")) {
+            inTrack = false;
+        }
+    }
+
+    if(xml.hasError()) {
+        qWarning() << "Playlist: XSPF error at line" << xml.lineNumber() << xml.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+// title of an entry, the file name if it has none
+QString entryTitle(const PlaylistStore& store, int item)
+{
+    const QString song = store.song(item);
+    return song.isEmpty() ? QFileInfo(store.fileName(item)).completeBaseName() : song;
+}
+
+bool writeText(QSaveFile& file, PlaylistFile::Format format, const PlaylistStore& store, const QVector<int>& order)
+{
+    PathWriter writer(file.fileName(), store, false);
+
+    QByteArray buffer;
+    // reserved, so resize(0) keeps the allocation
+    buffer.reserve(write_chunk_size + 4096);
+
+    auto flush = [&](bool force) {
+        if(force || buffer.size() >= write_chunk_size) {
+            file.write(buffer);
+            buffer.resize(0);
+        }
+    };
+
+    buffer += format == PlaylistFile::Format::M3u ? "#EXTM3U\n" : "[playlist]\n";
+
+    for(int i = 0; i < order.size(); ++i) {
+        const int item = order.at(i);
+
+        const QByteArray path = writer.path(store, item).toUtf8();
+        const QByteArray title = entryTitle(store, item).toUtf8();
+        // -1 is unknown
+        const qint64 seconds = store.duration(item) > 0 ? store.duration(item) / 1000 : -1;
+
+        if(format == PlaylistFile::Format::M3u) {
+            const QString& artist = store.artist(item);
+
+            buffer += "#EXTINF:" + QByteArray::number(seconds) + ',';
+            if(!artist.isEmpty()) {
+                buffer += artist.toUtf8() + " - ";
+            }
+            buffer += title + '\n' + path + '\n';
+        } else {
+            const QByteArray number = QByteArray::number(i + 1);
+
+            buffer += "File" + number + '=' + path + '\n';
+            buffer += "Title" + number + '=' + title + '\n';
+            buffer += "Length" + number + '=' + QByteArray::number(seconds) + '\n';
+        }
+
+        flush(false);
+    }
+
+    if(format == PlaylistFile::Format::Pls) {
+        buffer += "NumberOfEntries=" + QByteArray::number(order.size()) + "\nVersion=2\n";
+    }
+
+    flush(true);
+    return true;
+}
+
+bool writeXspf(QSaveFile& file, const PlaylistStore& store, const QVector<int>& order)
+{
+    PathWriter writer(file.fileName(), store, true);
+
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeDefaultNamespace("http://xspf.org/ns/0/");
+    xml.writeStartElement("playlist");
+    xml.writeAttribute("version", "1");
+    xml.writeStartElement("trackList");
+
+    for(int item : order) {
+        xml.writeStartElement("track");
+        xml.writeTextElement("location", writer.path(store, item));
+        xml.writeTextElement("title", entryTitle(store, item));
+
+        if(!store.artist(item).isEmpty()) {
+            xml.writeTextElement("creator", store.artist(item));
+        }
+        if(!store.album(item).isEmpty()) {
+            xml.writeTextElement("album", store.album(item));
+        }
+        if(store.duration(item) > 0) {
+            xml.writeTextElement("duration", QString::number(store.duration(item)));
+        }
+
+        xml.writeEndElement();
+    }
+
+    xml.writeEndElement();
+    xml.writeEndElement();
+    xml.writeEndDocument();
+
+    return !xml.hasError();
+}
+
+} // namespace
+
+PlaylistFile::Format PlaylistFile::format(const QString &fileName)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+
+    if(suffix == "m3u" || suffix == "m3u8") {
+        return Format::M3u;
+    }
+    if(suffix == "pls") {
+        return Format::Pls;
+    }
+    if(suffix == "xspf") {
+        return Format::Xspf;
+    }
+
+    return Format::Unknown;
+}
+
+bool PlaylistFile::read(const QString &fileName, QStringList &paths)
+{
+    const Format type = format(fileName);
+    if(type == Format::Unknown) {
+        qWarning() << "Playlist: unknown format of" << fileName;
+        return false;
+    }
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Playlist: could not read" << fileName;
+        return false;
+    }
+
+    // read if it can not be mapped, e.g. from some network file systems
+    QByteArray buffer;
+    qint64 size = file.size();
+    const char* data = size > 0 ? reinterpret_cast<const char*>(file.map(0, size)) : nullptr;
+    if(!data) {
+        buffer = file.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+
+    PathResolver resolver(fileName);
+    bool parsed = true;
+
+    switch(type) {
+    case Format::M3u: {
+        // .m3u8 is UTF-8, older .m3u files are often in the system encoding
+        const bool utf8 = QFileInfo(fileName).suffix().toLower() == "m3u8" || isUtf8(data, size);
+        readM3u(data, size, utf8, resolver, paths);
+        break;
+    }
+    case Format::Pls:
+        readPls(data, size, resolver, paths);
+        break;
+    case Format::Xspf:
+        parsed = readXspf(data, size, resolver, paths);
+        break;
+    case Format::Unknown:
+        break;
+    }
+
+    return parsed;
+}
+
+bool PlaylistFile::write(const QString &fileName, const PlaylistStore &store, const QVector<int> &order)
+{
+    const Format type = format(fileName);
+    if(type == Format::Unknown) {
+        qWarning() << "Playlist: unknown format of" << fileName;
+        return false;
+    }
+
+    // replaces the old playlist only once complete
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Playlist: could not write" << fileName;
+        return false;
+    }
+
+    const bool written = type == Format::Xspf
+            ? writeXspf(file, store, order)
+            : writeText(file, type, store, order);
+
+    if(!written || !file.commit()) {
+        qWarning() << "Playlist: could not write" << fileName << file.errorString();
+        return false;
+    }
+
+    return true;
+}
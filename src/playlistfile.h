@@ -0,0 +1,36 @@
+#ifndef PLAYLISTFILE_H
+#define PLAYLISTFILE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class PlaylistStore;
+
+//! Reads and writes M3U/M3U8, PLS and XSPF playlists, the format follows the file suffix.
+//! Files are mapped and parsed in one pass, XSPF with a stream reader instead
+//! of a DOM. Only paths are read, tags are left to the tag scanner. Relative
+//! paths are resolved against the playlist directory, once per directory
+//! they name. Paths are written relative to the playlist where possible.
+//! Text is always UTF-8, remote entries are skipped.
+class PlaylistFile
+{
+public:
+    enum class Format {
+        M3u,
+        Pls,
+        Xspf,
+        Unknown
+    };
+
+    static Format format(const QString& fileName);
+
+    //! Absolute paths of the entries in playlist order.
+    //! Returns false if the file could not be read or parsed, paths read before an error are kept.
+    static bool read(const QString& fileName, QStringList& paths);
+
+    //! Write the entries of a store in the given order.
+    static bool write(const QString& fileName, const PlaylistStore& store, const QVector<int>& order);
+};
+
+#endif // PLAYLISTFILE_H
@@ -1,7 +1,12 @@
 #include "playlistitemmodel.h"
+#include "playlistfile.h"
+#include "tagscanner.h"
 
 #include <QFileInfo>
 
+#include <algorithm>
+#include <functional>
+
 int PlaylistItemModel::currentIndex() const
 {
     return m_currentIndex;
@@ -16,29 +21,192 @@ void PlaylistItemModel::setCurrentIndex(int currentIndex)
 }
 
 PlaylistItemModel::PlaylistItemModel(QObject *parent)
-    : QAbstractListModel(parent), m_currentIndex(-1)
+    : QAbstractListModel(parent),
+      m_currentIndex(-1),
+      m_tagScanner(new TagScanner(this))
 {
+    connect(m_tagScanner, &TagScanner::batchScanned,
+            this, &PlaylistItemModel::applyTags,
+            Qt::QueuedConnection);
 }
 
 void PlaylistItemModel::addPlaylistItem(const AudioTagInfo& item)
 {
     beginInsertRows(QModelIndex(), rowCount(), rowCount());
-    m_playlist.push_back(item);
+    m_rows.append(m_order.size());
+    m_order.append(m_playlist.size());
+    m_playlist.append(item);
+    endInsertRows();
+}
+
+void PlaylistItemModel::addPlaylistItems(const QList<AudioTagInfo> &items)
+{
+    if(items.isEmpty()) {
+        return;
+    }
+
+    // views lay out once for the whole range
+    beginInsertRows(QModelIndex(), rowCount(), rowCount() + items.size() - 1);
+    m_playlist.reserve(m_playlist.size() + items.size());
+    m_order.reserve(m_order.size() + items.size());
+    m_rows.reserve(m_rows.size() + items.size());
+    for(const AudioTagInfo& item : items) {
+        m_rows.append(m_order.size());
+        m_order.append(m_playlist.size());
+        m_playlist.append(item);
+    }
     endInsertRows();
 }
 
 void PlaylistItemModel::addFilename(const QString& filename)
 {
     auto path = QFileInfo(filename).absoluteFilePath();
-    AudioTagInfo item(path);
+    const int item = m_playlist.size();
 
-    addPlaylistItem(std::move(item));
+    addPlaylistItem(AudioTagInfo::placeholder(path));
+    scanTags({path}, item);
 }
 
 void PlaylistItemModel::addFilenameList(const QList<QUrl>& filenameList)
 {
+    QStringList paths;
+    paths.reserve(filenameList.size());
+
     for(auto &&filename : filenameList) {
-        addFilename(filename.toLocalFile());
+        paths << QFileInfo(filename.toLocalFile()).absoluteFilePath();
+    }
+
+    addFilePaths(paths);
+}
+
+void PlaylistItemModel::addFilePaths(const QStringList &paths)
+{
+    const int firstItem = m_playlist.size();
+
+    QList<AudioTagInfo> items;
+    items.reserve(paths.size());
+
+    for(const QString& path : paths) {
+        items << AudioTagInfo::placeholder(path);
+    }
+
+    addPlaylistItems(items);
+    scanTags(paths, firstItem);
+}
+
+bool PlaylistItemModel::importPlaylist(const QString &fileName)
+{
+    QStringList paths;
+    const bool parsed = PlaylistFile::read(fileName, paths);
+
+    // entries before a parse error are still added
+    addFilePaths(paths);
+
+    return parsed;
+}
+
+bool PlaylistItemModel::exportPlaylist(const QString &fileName) const
+{
+    return PlaylistFile::write(fileName, m_playlist, m_order);
+}
+
+void PlaylistItemModel::scanTags(const QStringList &paths, int firstItem)
+{
+    if(!paths.isEmpty()) {
+        m_scans.insert(m_tagScanner->scan(paths), Scan{firstItem, paths.size()});
+    }
+}
+
+int PlaylistItemModel::findScannedItem(int item, const QString &path) const
+{
+    if(item >= 0 && item < m_playlist.size() && m_playlist.path(item) == path) {
+        return item;
+    }
+
+    // items before it were removed while scanning, it moved up
+    for(int i = std::min(item, m_playlist.size() - 1); i >= 0; --i) {
+        if(m_playlist.path(i) == path) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void PlaylistItemModel::applyTags(quint64 scan, int first, const QVector<AudioTagInfo> &tags)
+{
+    // the playlist was cleared meanwhile
+    auto running = m_scans.find(scan);
+    if(running == m_scans.end()) {
+        return;
+    }
+
+    const int firstItem = running->firstItem + first;
+    running->remaining -= tags.size();
+    if(running->remaining <= 0) {
+        m_scans.erase(running);
+    }
+
+    QVector<int> rows;
+    rows.reserve(tags.size());
+
+    for(int i = 0; i < tags.size(); ++i) {
+        const int item = findScannedItem(firstItem + i, tags.at(i).path);
+        if(item < 0) {
+            continue;
+        }
+
+        m_playlist.setTags(item, tags.at(i));
+        rows.append(m_rows.at(item));
+    }
+
+    // one dataChanged for every run of adjacent rows, a sorted playlist scatters them
+    std::sort(rows.begin(), rows.end());
+
+    for(int first = 0, last = 0; first < rows.size(); first = last) {
+        for(last = first + 1; last < rows.size() && rows.at(last) == rows.at(last - 1) + 1; ++last) {
+        }
+
+        emit dataChanged(index(rows.at(first)), index(rows.at(last - 1)));
+    }
+}
+
+void PlaylistItemModel::sortBy(PlaylistSorter::SortKey key, Qt::SortOrder order)
+{
+    const QList<QPersistentModelIndex> parents;
+    emit layoutAboutToBeChanged(parents, QAbstractItemModel::VerticalSortHint);
+
+    // entries do not move, so what rows point to stays valid
+    const QModelIndexList persistent = persistentIndexList();
+    QVector<int> persistentItems;
+    persistentItems.reserve(persistent.size());
+    for(const QModelIndex& index : persistent) {
+        persistentItems.append(m_order.at(index.row()));
+    }
+
+    const int currentItem = isValidIndex(m_currentIndex) ? m_order.at(m_currentIndex) : -1;
+
+    m_order = PlaylistSorter::sort(m_playlist, m_order, key, order);
+    updateRows();
+
+    QModelIndexList moved;
+    moved.reserve(persistentItems.size());
+    for(int item : persistentItems) {
+        moved.append(index(m_rows.at(item)));
+    }
+    changePersistentIndexList(persistent, moved);
+
+    // the same file stays current, nothing is reloaded
+    m_currentIndex = currentItem >= 0 ? m_rows.at(currentItem) : -1;
+
+    emit layoutChanged(parents, QAbstractItemModel::VerticalSortHint);
+}
+
+void PlaylistItemModel::updateRows()
+{
+    m_rows.resize(m_order.size());
+    for(int row = 0; row < m_order.size(); ++row) {
+        m_rows[m_order.at(row)] = row;
     }
 }
 
@@ -49,20 +217,26 @@ void PlaylistItemModel::remove(int index)
     removeRows(index, 1, QModelIndex());
 }
 
-AudioTagInfo PlaylistItemModel::getFileInfo(int index) const
+QString PlaylistItemModel::filePath(int index) const
 {
     Q_ASSERT(isValidIndex(index));
 
-    return m_playlist.at(index);
+    return m_playlist.path(m_order.at(index));
 }
 
-AudioTagInfo PlaylistItemModel::currentFileInfo() const
+int PlaylistItemModel::itemIndex(int row) const
 {
-    if(m_currentIndex >= 0) {
-       return getFileInfo(m_currentIndex);
-    } else {
-       return AudioTagInfo();
-    }
+    return m_order.at(row);
+}
+
+int PlaylistItemModel::rowOfItem(int item) const
+{
+    return m_rows.at(item);
+}
+
+const PlaylistStore &PlaylistItemModel::items() const
+{
+    return m_playlist;
 }
 
 bool PlaylistItemModel::isValidIndex(int index) const
@@ -72,15 +246,20 @@ bool PlaylistItemModel::isValidIndex(int index) const
 
 int PlaylistItemModel::size() const
 {
-    return m_playlist.count();
+    return m_playlist.size();
 }
 
 void PlaylistItemModel::reset()
 {
     m_currentIndex = -1;
 
+    m_tagScanner->cancel();
+    m_scans.clear();
+
     beginResetModel();
     m_playlist.clear();
+    m_order.clear();
+    m_rows.clear();
     endResetModel();
 }
 
@@ -95,20 +274,22 @@ QVariant PlaylistItemModel::data(const QModelIndex &index, int role) const
     if (!index.isValid())
         return QVariant();
 
-    if (index.row() < 0 || index.row() >= m_playlist.count())
+    if (!isValidIndex(index.row()))
         return QVariant();
 
-    const auto& item = m_playlist[index.row()];
+    const int item = m_order.at(index.row());
     switch(role)
     {
     case NameRole:
-        return item.song;
+        return m_playlist.song(item);
     case ArtistRole:
-        return item.artist;
+        return m_playlist.artist(item);
     case FileNameRole:
-        return item.fileName;
+        return m_playlist.fileName(item);
     case DurationRole:
-        return item.duration;
+        return m_playlist.duration(item);
+    case AlbumRole:
+        return m_playlist.album(item);
     default:
         return QVariant();
     }
@@ -118,7 +299,8 @@ QVariant PlaylistItemModel::data(const QModelIndex &index, int role) const
 const QHash<int, QByteArray> PlaylistItemModel::m_roles {{PlaylistItemModel::NameRole, "name"},
                                                          {PlaylistItemModel::ArtistRole, "artist"},
                                                          {PlaylistItemModel::FileNameRole, "fileName"},
-                                                         {PlaylistItemModel::DurationRole, "duration"}};
+                                                         {PlaylistItemModel::DurationRole, "duration"},
+                                                         {PlaylistItemModel::AlbumRole, "album"}};
 
 QHash<int, QByteArray> PlaylistItemModel::roleNames() const
 {
@@ -132,11 +314,25 @@ bool PlaylistItemModel::removeRows(int row, int count, const QModelIndex& /* par
 
     int lastRow = row + count - 1;
 
+    // entries of the rows, from the last one so indices stay valid
+    QVector<int> removed = m_order.mid(row, count);
+    std::sort(removed.begin(), removed.end(), std::greater<int>());
+
     beginRemoveRows(QModelIndex(), row, lastRow);
-    m_playlist.erase(m_playlist.begin() + row, m_playlist.begin() + lastRow + 1);
+    for(int item : removed) {
+        m_playlist.remove(item, 1);
+    }
+
+    // entries after removed ones moved up
+    m_order.remove(row, count);
+    for(int& item : m_order) {
+        item -= static_cast<int>(removed.cend() - std::lower_bound(removed.cbegin(), removed.cend(), item,
+                                                                   std::greater<int>()));
+    }
+    updateRows();
     endRemoveRows();
 
-    if(m_playlist.empty()) {
+    if(m_playlist.size() == 0) {
         // no items left
         setCurrentIndex(-1);
     } else if(row >= m_currentIndex
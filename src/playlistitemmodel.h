@@ -6,16 +6,38 @@
 #include <QHash>
 #include <QByteArray>
 #include <QUrl>
+#include <QVector>
 
 #include "audiotaginfo.h"
+#include "playlistsorter.h"
+#include "playliststore.h"
+
+class TagScanner;
 
 class PlaylistItemModel : public QAbstractListModel
 {
     Q_OBJECT
 
-    QList<AudioTagInfo> m_playlist;
+    PlaylistStore m_playlist;
     int m_currentIndex;
 
+    // entries stay in the order they were added, rows show them in m_order
+    QVector<int> m_order;
+    // row of every entry, inverse of m_order
+    QVector<int> m_rows;
+
+    // rows are added with file names only, tags fill in as they are read
+    TagScanner* m_tagScanner;
+    struct Scan {
+        int firstItem;
+        int remaining;
+    };
+    QHash<quint64, Scan> m_scans;
+
+    void scanTags(const QStringList& paths, int firstItem);
+    int findScannedItem(int item, const QString& path) const;
+    void updateRows();
+
 // QAbstractListModel interface
 public:
     bool removeRows(int row, int count, const QModelIndex &parent) override;
@@ -34,15 +56,32 @@ public:
         NameRole = Qt::UserRole + 1,
         ArtistRole,
         FileNameRole,
-        DurationRole
+        DurationRole,
+        AlbumRole
     };
 
     void addPlaylistItem(const AudioTagInfo& item);
+    //! One insertion for all items, views lay out once.
+    void addPlaylistItems(const QList<AudioTagInfo>& items);
     void addFilename(const QString& filename);
     void addFilenameList(const QList<QUrl>& filenameList);
+    //! Absolute paths, tags are read in the background.
+    void addFilePaths(const QStringList& paths);
+
+    //! Append the entries of an M3U, PLS or XSPF playlist, see PlaylistFile.
+    bool importPlaylist(const QString& fileName);
+    //! Write the rows in their current order, the format follows the suffix.
+    bool exportPlaylist(const QString& fileName) const;
 
-    AudioTagInfo getFileInfo(int index) const;
-    AudioTagInfo currentFileInfo() const;
+    QString filePath(int index) const;
+    //! Entries in the order they were added, see itemIndex().
+    const PlaylistStore& items() const;
+    //! Entry shown in a row.
+    int itemIndex(int row) const;
+    int rowOfItem(int item) const;
+
+    //! Reorder rows, the current file stays current. Emits one layout change.
+    void sortBy(PlaylistSorter::SortKey key, Qt::SortOrder order);
 
     bool isValidIndex(int index) const;
 
@@ -56,6 +95,9 @@ signals:
     void fileRemoved(QString filename);
     void fileAdded(QString filename);
     void currentIndexChanged(int index);
+
+private slots:
+    void applyTags(quint64 scan, int first, const QVector<AudioTagInfo>& tags);
 };
 
 #endif // PLAYLISTITEMMODEL_H
@@ -0,0 +1,354 @@
+#include "playlistsearchindex.h"
+
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+// recent postings are merged when they are this share of the sorted ones
+constexpr int recent_merge_ratio = 8;
+constexpr int min_recent_merge = 4096;
+
+// removed entries are dropped from the postings when they are this share of all entries
+constexpr int removed_compact_ratio = 64;
+constexpr int min_removed_compact = 1024;
+
+// stale postings are dropped when they are this share of all postings
+constexpr int stale_compact_ratio = 2;
+constexpr int min_stale_compact = 4096;
+
+PlaylistSearchIndex::Matches::Matches(int size)
+    : m_bits((size + 63) / 64, 0),
+      m_size(size),
+      m_count(0)
+{
+}
+
+int PlaylistSearchIndex::Matches::size() const
+{
+    return m_size;
+}
+
+int PlaylistSearchIndex::Matches::count() const
+{
+    return m_count;
+}
+
+bool PlaylistSearchIndex::Matches::contains(int item) const
+{
+    return (m_bits.at(item / 64) >> (item % 64)) & 1;
+}
+
+QVector<int> PlaylistSearchIndex::Matches::items() const
+{
+    QVector<int> items;
+    items.reserve(m_count);
+
+    for(int block = 0; block < m_bits.size(); ++block) {
+        for(quint64 bits = m_bits.at(block); bits != 0; bits &= bits - 1) {
+            items.append(block * 64 + static_cast<int>(qCountTrailingZeroBits(bits)));
+        }
+    }
+
+    return items;
+}
+
+void PlaylistSearchIndex::Matches::set(int item, bool match)
+{
+    if(contains(item) == match) {
+        return;
+    }
+
+    m_bits[item / 64] ^= quint64(1) << (item % 64);
+    m_count += match ? 1 : -1;
+}
+
+void PlaylistSearchIndex::Matches::resize(int size)
+{
+    Q_ASSERT(size >= m_size);
+
+    m_bits.resize((size + 63) / 64);
+    m_size = size;
+}
+
+void PlaylistSearchIndex::Matches::remove(int item)
+{
+    set(item, false);
+
+    // bits above the entry move down by one, the lowest of the next block comes in on top
+    const int block = item / 64;
+    const int bit = item % 64;
+    const quint64 below = m_bits.at(block) & ((quint64(1) << bit) - 1);
+
+    for(int i = block; i < m_bits.size(); ++i) {
+        const quint64 carry = i + 1 < m_bits.size() ? m_bits.at(i + 1) & 1 : 0;
+        m_bits[i] = (i == block ? below | ((m_bits.at(i) >> bit >> 1) << bit) : m_bits.at(i) >> 1) | carry << 63;
+    }
+
+    --m_size;
+    m_bits.resize((m_size + 63) / 64);
+}
+
+PlaylistSearchIndex::PlaylistSearchIndex()
+    : m_recentSorted(true),
+      m_stalePostings(0)
+{
+}
+
+QStringList PlaylistSearchIndex::words(const QString &text)
+{
+    QStringList words;
+    QString word;
+
+    for(const QChar c : text) {
+        if(c.isLetterOrNumber()) {
+            word += c.toCaseFolded();
+        } else if(!word.isEmpty()) {
+            words << word;
+            word.clear();
+        }
+    }
+
+    if(!word.isEmpty()) {
+        words << word;
+    }
+
+    return words;
+}
+
+void PlaylistSearchIndex::clear()
+{
+    m_words.clear();
+    m_wordIds.clear();
+    m_sorted.clear();
+    m_recent.clear();
+    m_recentSorted = true;
+    m_entries.clear();
+    m_removed.clear();
+    m_stalePostings = 0;
+}
+
+quint32 PlaylistSearchIndex::internWord(const QString &word)
+{
+    auto id = m_wordIds.constFind(word);
+    if(id != m_wordIds.constEnd()) {
+        return *id;
+    }
+
+    const quint32 newId = static_cast<quint32>(m_words.size());
+    m_words.append(word);
+    m_wordIds.insert(word, newId);
+
+    return newId;
+}
+
+quint32 PlaylistSearchIndex::postedId(int item) const
+{
+    // the i-th removed id has 'removed - i' entries before it
+    int low = 0;
+    int high = m_removed.size();
+    while(low < high) {
+        const int middle = (low + high) / 2;
+        if(static_cast<int>(m_removed.at(middle)) - middle <= item) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return static_cast<quint32>(item + low);
+}
+
+int PlaylistSearchIndex::itemOf(quint32 posted) const
+{
+    auto removed = std::lower_bound(m_removed.cbegin(), m_removed.cend(), posted);
+
+    return static_cast<int>(posted) - static_cast<int>(removed - m_removed.cbegin());
+}
+
+void PlaylistSearchIndex::setItem(int item, const QStringList &fields)
+{
+    const quint32 posted = postedId(item);
+    if(posted < static_cast<quint32>(m_entries.size())) {
+        // the words it had are stale
+        m_stalePostings += static_cast<int>(m_entries.at(posted).postings);
+        ++m_entries[posted].version;
+    } else {
+        m_entries.resize(posted + 1);
+    }
+
+    QVector<quint32> ids;
+    for(const QString& field : fields) {
+        for(const QString& word : words(field)) {
+            ids.append(internWord(word));
+        }
+    }
+
+    // artist names are often in file names too
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    Entry& entry = m_entries[posted];
+    entry.postings = static_cast<quint32>(ids.size());
+    for(quint32 id : ids) {
+        m_recent.append(Posting{id, posted, entry.version});
+    }
+    m_recentSorted = m_recentSorted && ids.isEmpty();
+
+    if(m_recent.size() >= std::max(min_recent_merge, m_sorted.size() / recent_merge_ratio)) {
+        merge();
+    }
+
+    compactIfStale();
+}
+
+void PlaylistSearchIndex::removeItem(int item)
+{
+    const quint32 posted = postedId(item);
+
+    Entry& entry = m_entries[posted];
+    m_stalePostings += static_cast<int>(entry.postings);
+    entry.postings = 0;
+    ++entry.version;
+
+    m_removed.insert(std::lower_bound(m_removed.begin(), m_removed.end(), posted), posted);
+
+    compactIfStale();
+}
+
+void PlaylistSearchIndex::compactIfStale()
+{
+    const int postings = m_sorted.size() + m_recent.size();
+
+    if(m_removed.size() >= std::max(min_removed_compact, m_entries.size() / removed_compact_ratio)
+            || m_stalePostings >= std::max(min_stale_compact, postings / stale_compact_ratio)) {
+        compact();
+    }
+}
+
+void PlaylistSearchIndex::compact()
+{
+    // order by word is kept, entries after removed ones move up
+    for(QVector<Posting>* postings : { &m_sorted, &m_recent }) {
+        auto last = std::remove_if(postings->begin(), postings->end(), [this](const Posting& posting) {
+            return posting.version != m_entries.at(posting.item).version;
+        });
+        postings->erase(last, postings->end());
+
+        for(Posting& posting : *postings) {
+            posting.item = static_cast<quint32>(itemOf(posting.item));
+        }
+    }
+
+    QVector<Entry> entries;
+    entries.reserve(m_entries.size() - m_removed.size());
+    for(int posted = 0; posted < m_entries.size(); ++posted) {
+        if(!std::binary_search(m_removed.cbegin(), m_removed.cend(), static_cast<quint32>(posted))) {
+            entries.append(m_entries.at(posted));
+        }
+    }
+
+    m_entries.swap(entries);
+    m_removed.clear();
+    m_stalePostings = 0;
+}
+
+void PlaylistSearchIndex::sortPostings(QVector<Posting> &postings) const
+{
+    std::sort(postings.begin(), postings.end(), [this](const Posting& a, const Posting& b) {
+        return a.word == b.word ? a.item < b.item : m_words.at(a.word) < m_words.at(b.word);
+    });
+}
+
+void PlaylistSearchIndex::merge()
+{
+    if(!m_recentSorted) {
+        sortPostings(m_recent);
+    }
+
+    QVector<Posting> merged;
+    merged.reserve(m_sorted.size() + m_recent.size());
+
+    std::merge(m_sorted.cbegin(), m_sorted.cend(), m_recent.cbegin(), m_recent.cend(),
+               std::back_inserter(merged), [this](const Posting& a, const Posting& b) {
+        return a.word == b.word ? a.item < b.item : m_words.at(a.word) < m_words.at(b.word);
+    });
+
+    m_sorted.swap(merged);
+    m_recent.clear();
+    m_recentSorted = true;
+}
+
+void PlaylistSearchIndex::markPrefix(const QVector<Posting> &postings, const QString &prefix, Matches &items) const
+{
+    // words with the prefix are one run of the sorted postings
+    auto first = std::lower_bound(postings.cbegin(), postings.cend(), prefix,
+                                  [this](const Posting& posting, const QString& prefix) {
+        return m_words.at(posting.word) < prefix;
+    });
+    auto last = std::partition_point(first, postings.cend(), [this, &prefix](const Posting& posting) {
+        return m_words.at(posting.word).startsWith(prefix);
+    });
+
+    quint64* bits = items.m_bits.data();
+    for(; first != last; ++first) {
+        // words of retagged and removed entries
+        if(first->version != m_entries.at(first->item).version) {
+            continue;
+        }
+
+        const int item = m_removed.isEmpty() ? static_cast<int>(first->item) : itemOf(first->item);
+        bits[item / 64] |= quint64(1) << (item % 64);
+    }
+}
+
+PlaylistSearchIndex::Matches PlaylistSearchIndex::find(const QString &query)
+{
+    if(!m_recentSorted) {
+        sortPostings(m_recent);
+        m_recentSorted = true;
+    }
+
+    // a bit per entry, so a short prefix with most entries costs no sort
+    const int size = m_entries.size() - m_removed.size();
+    const QStringList terms = words(query);
+
+    Matches matched(size);
+    bool first = true;
+
+    for(const QString& term : terms) {
+        Matches items(size);
+        markPrefix(m_sorted, term, items);
+        markPrefix(m_recent, term, items);
+
+        if(first) {
+            std::swap(matched, items);
+            first = false;
+        } else {
+            for(int block = 0; block < matched.m_bits.size(); ++block) {
+                matched.m_bits[block] &= items.m_bits.at(block);
+            }
+        }
+    }
+
+    for(int block = 0; block < matched.m_bits.size(); ++block) {
+        matched.m_count += static_cast<int>(qPopulationCount(matched.m_bits.at(block)));
+    }
+
+    return matched;
+}
+
+bool PlaylistSearchIndex::matches(const QStringList &terms, const QStringList &fields)
+{
+    QStringList fieldWords;
+    for(const QString& field : fields) {
+        fieldWords << words(field);
+    }
+
+    return !terms.isEmpty() && std::all_of(terms.cbegin(), terms.cend(), [&fieldWords](const QString& term) {
+        return std::any_of(fieldWords.cbegin(), fieldWords.cend(), [&term](const QString& word) {
+            return word.startsWith(term);
+        });
+    });
+}
@@ -0,0 +1,106 @@
+#ifndef PLAYLISTSEARCHINDEX_H
+#define PLAYLISTSEARCHINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+//! Word prefix index over playlist entries, for type-ahead search.
+//! Every word of an entry's fields is interned once and paired with the entry.
+//! Pairs are kept sorted by word, so the entries with a word starting with
+//! a query term are one binary search away. Entries added since the last
+//! merge go to a second run that is sorted on the next query and merged
+//! once it grows, which keeps imports cheap.
+//! Words of retagged and removed entries are only marked stale, they are
+//! dropped and the ids after removed entries renumbered once there are many.
+//! Entries are indices into the playlist store, sorting rows leaves them be.
+class PlaylistSearchIndex
+{
+    struct Posting {
+        quint32 word;
+        quint32 item;
+        // of the entry when the word was added, older ones are stale
+        quint32 version;
+    };
+
+    struct Entry {
+        quint32 version;
+        quint32 postings;
+    };
+
+    // distinct case folded words
+    QVector<QString> m_words;
+    QHash<QString, quint32> m_wordIds;
+
+    // postings keep the id an entry had when it was added
+    QVector<Posting> m_sorted;
+    QVector<Posting> m_recent;
+    bool m_recentSorted;
+
+    // by posted id, removed ones included
+    QVector<Entry> m_entries;
+    // posted ids of removed entries, ascending
+    QVector<quint32> m_removed;
+    int m_stalePostings;
+
+    quint32 internWord(const QString& word);
+    quint32 postedId(int item) const;
+    int itemOf(quint32 posted) const;
+    void sortPostings(QVector<Posting>& postings) const;
+    void merge();
+    void compact();
+    void compactIfStale();
+
+public:
+    //! Entries found by a query, a bit for each entry of the playlist.
+    class Matches
+    {
+        QVector<quint64> m_bits;
+        int m_size;
+        int m_count;
+
+        friend class PlaylistSearchIndex;
+
+    public:
+        explicit Matches(int size = 0);
+
+        int size() const;
+        //! Entries that match.
+        int count() const;
+        bool contains(int item) const;
+        //! Matching entries in ascending order.
+        QVector<int> items() const;
+
+        void set(int item, bool match);
+        //! More entries that do not match, e.g. when they are added.
+        void resize(int size);
+        //! Drop an entry, the ones after it move up like in the store.
+        void remove(int item);
+    };
+
+    PlaylistSearchIndex();
+
+    //! Case folded words of a text, split on anything but letters and digits.
+    static QStringList words(const QString& text);
+
+    void clear();
+
+    //! Set the words of an entry, e.g. when it is added or its tags are read.
+    //! Words it had before are dropped.
+    void setItem(int item, const QStringList& fields);
+
+    //! Drop an entry, the ones after it move up like in the store.
+    void removeItem(int item);
+
+    //! Entries with a word starting with every term of the query.
+    Matches find(const QString& query);
+
+    //! Whether every term starts a word of the fields, like find() does for an entry.
+    static bool matches(const QStringList& terms, const QStringList& fields);
+
+private:
+    void markPrefix(const QVector<Posting>& postings, const QString& prefix, Matches& items) const;
+};
+
+#endif // PLAYLISTSEARCHINDEX_H
@@ -0,0 +1,458 @@
+#include "playlistsearchmodel.h"
+#include "playlistitemmodel.h"
+
+#include <algorithm>
+#include <functional>
+
+// matches shown for a query at most, a single letter finds most of a library
+constexpr int max_matches = 5000;
+
+PlaylistSearchModel::PlaylistSearchModel(PlaylistItemModel *source, QObject *parent)
+    : QAbstractListModel(parent),
+      m_source(source),
+      m_removedFirst(0),
+      m_removedLast(-1)
+{
+    connect(m_source, &QAbstractItemModel::rowsAboutToBeInserted,
+            this, &PlaylistSearchModel::sourceRowsAboutToBeInserted);
+    connect(m_source, &QAbstractItemModel::rowsInserted,
+            this, &PlaylistSearchModel::sourceRowsInserted);
+    connect(m_source, &QAbstractItemModel::rowsAboutToBeRemoved,
+            this, &PlaylistSearchModel::sourceRowsAboutToBeRemoved);
+    connect(m_source, &QAbstractItemModel::rowsRemoved,
+            this, &PlaylistSearchModel::sourceRowsRemoved);
+    connect(m_source, &QAbstractItemModel::dataChanged,
+            this, &PlaylistSearchModel::sourceDataChanged);
+    connect(m_source, &QAbstractItemModel::modelAboutToBeReset,
+            this, &PlaylistSearchModel::sourceAboutToBeReset);
+    connect(m_source, &QAbstractItemModel::modelReset,
+            this, &PlaylistSearchModel::sourceReset);
+    connect(m_source, &QAbstractItemModel::layoutAboutToBeChanged,
+            this, &PlaylistSearchModel::sourceLayoutAboutToBeChanged);
+    connect(m_source, &QAbstractItemModel::layoutChanged,
+            this, &PlaylistSearchModel::sourceLayoutChanged);
+    connect(m_source, &PlaylistItemModel::currentIndexChanged,
+            this, &PlaylistSearchModel::sourceCurrentIndexChanged);
+
+    reindex();
+}
+
+bool PlaylistSearchModel::isFiltering() const
+{
+    return !m_query.trimmed().isEmpty();
+}
+
+QStringList PlaylistSearchModel::fields(int item) const
+{
+    const PlaylistStore& items = m_source->items();
+
+    return { items.song(item), items.artist(item), items.album(item), items.fileName(item) };
+}
+
+void PlaylistSearchModel::indexItem(int item)
+{
+    m_index.setItem(item, fields(item));
+}
+
+void PlaylistSearchModel::indexRows(int first, int last)
+{
+    for(int row = first; row <= last; ++row) {
+        indexItem(m_source->itemIndex(row));
+    }
+}
+
+void PlaylistSearchModel::reindex()
+{
+    m_index.clear();
+
+    for(int item = 0; item < m_source->items().size(); ++item) {
+        indexItem(item);
+    }
+}
+
+QVector<int> PlaylistSearchModel::findMatches() const
+{
+    QVector<int> rows;
+
+    if(m_found.count() <= max_matches) {
+        // shown in playlist order
+        for(int item : m_found.items()) {
+            rows.append(m_source->rowOfItem(item));
+        }
+        std::sort(rows.begin(), rows.end());
+    } else {
+        // most of the playlist for a short prefix, the first rows come soon
+        for(int row = 0; row < m_source->rowCount() && rows.size() < max_matches; ++row) {
+            if(m_found.contains(m_source->itemIndex(row))) {
+                rows.append(row);
+            }
+        }
+    }
+
+    return rows;
+}
+
+void PlaylistSearchModel::updateMatches(int first, int last)
+{
+    // rows whose entries start or stop matching, the index has their words already
+    QVector<int> matching;
+    QVector<int> gone;
+
+    for(int row = first; row <= last; ++row) {
+        const int item = m_source->itemIndex(row);
+        const bool match = PlaylistSearchIndex::matches(m_terms, fields(item));
+        if(match != m_found.contains(item)) {
+            (match ? matching : gone).append(row);
+        }
+    }
+
+    // hiding fills up with matches after the last one shown, new ones are not among them yet
+    for(int row : gone) {
+        m_found.set(m_source->itemIndex(row), false);
+    }
+    hideMatches(gone);
+
+    for(int row : matching) {
+        m_found.set(m_source->itemIndex(row), true);
+    }
+    showMatches(matching);
+}
+
+void PlaylistSearchModel::showMatches(QVector<int> rows)
+{
+    // rows after the last one shown wait for fillMatches() while others there are not shown
+    if(m_found.count() - rows.size() > m_matches.size()) {
+        const int lastShown = m_matches.isEmpty() ? -1 : m_matches.last();
+        rows.erase(std::upper_bound(rows.begin(), rows.end(), lastShown), rows.end());
+    }
+    if(rows.size() > max_matches) {
+        rows.resize(max_matches);
+    }
+
+    // one insertion for every run of new rows between shown ones
+    for(int next = 0, end = 0; next < rows.size(); next = end) {
+        const int position = static_cast<int>(std::lower_bound(m_matches.cbegin(), m_matches.cend(), rows.at(next))
+                                              - m_matches.cbegin());
+        for(end = next + 1; end < rows.size()
+            && (position == m_matches.size() || m_matches.at(position) > rows.at(end)); ++end) {
+        }
+
+        beginInsertRows(QModelIndex(), position, position + end - next - 1);
+        m_matches.insert(m_matches.begin() + position, end - next, 0);
+        std::copy(rows.cbegin() + next, rows.cbegin() + end, m_matches.begin() + position);
+        endInsertRows();
+    }
+
+    // the last ones make room
+    if(m_matches.size() > max_matches) {
+        beginRemoveRows(QModelIndex(), max_matches, m_matches.size() - 1);
+        m_matches.resize(max_matches);
+        endRemoveRows();
+    }
+
+    fillMatches();
+}
+
+void PlaylistSearchModel::hideMatches(const QVector<int> &rows)
+{
+    // one removal for every run of adjacent shown rows, from the last one
+    for(int end = rows.size(), next = end; end > 0; end = next) {
+        auto shown = std::lower_bound(m_matches.cbegin(), m_matches.cend(), rows.at(end - 1));
+        if(shown == m_matches.cend() || *shown != rows.at(end - 1)) {
+            next = end - 1;
+            continue;
+        }
+
+        const int last = static_cast<int>(shown - m_matches.cbegin());
+        int first = last;
+        for(next = end - 1; next > 0 && first > 0 && m_matches.at(first - 1) == rows.at(next - 1); --next) {
+            --first;
+        }
+
+        beginRemoveRows(QModelIndex(), first, last);
+        m_matches.remove(first, last - first + 1);
+        endRemoveRows();
+    }
+
+    fillMatches();
+}
+
+void PlaylistSearchModel::fillMatches()
+{
+    if(m_matches.size() >= max_matches || m_matches.size() >= m_found.count()) {
+        return;
+    }
+
+    // the next matching rows after the last one shown
+    QVector<int> rows;
+    for(int row = m_matches.isEmpty() ? 0 : m_matches.last() + 1;
+        row < m_source->rowCount() && m_matches.size() + rows.size() < std::min(max_matches, m_found.count()); ++row) {
+        if(m_found.contains(m_source->itemIndex(row))) {
+            rows.append(row);
+        }
+    }
+
+    if(!rows.isEmpty()) {
+        beginInsertRows(QModelIndex(), m_matches.size(), m_matches.size() + rows.size() - 1);
+        m_matches << rows;
+        endInsertRows();
+    }
+}
+
+QString PlaylistSearchModel::query() const
+{
+    return m_query;
+}
+
+void PlaylistSearchModel::setQuery(const QString &query)
+{
+    if(query == m_query) {
+        return;
+    }
+
+    beginResetModel();
+    m_query = query;
+    m_terms = PlaylistSearchIndex::words(query);
+    m_found = isFiltering() ? m_index.find(query) : PlaylistSearchIndex::Matches();
+    m_matches = findMatches();
+    endResetModel();
+
+    emit queryChanged();
+    emit matchCountChanged();
+    emit currentIndexChanged(rowFromSource(m_source->currentIndex()));
+}
+
+int PlaylistSearchModel::totalMatches() const
+{
+    return isFiltering() ? m_found.count() : m_source->rowCount();
+}
+
+bool PlaylistSearchModel::isTruncated() const
+{
+    return isFiltering() && m_found.count() > m_matches.size();
+}
+
+int PlaylistSearchModel::sourceRow(int row) const
+{
+    if(!isFiltering()) {
+        return row;
+    }
+
+    return row >= 0 && row < m_matches.size() ? m_matches.at(row) : -1;
+}
+
+int PlaylistSearchModel::rowFromSource(int sourceRow) const
+{
+    if(!isFiltering() || sourceRow < 0) {
+        return sourceRow;
+    }
+
+    auto match = std::lower_bound(m_matches.cbegin(), m_matches.cend(), sourceRow);
+    return match != m_matches.cend() && *match == sourceRow
+            ? static_cast<int>(match - m_matches.cbegin())
+            : -1;
+}
+
+void PlaylistSearchModel::sourceRowsAboutToBeInserted(const QModelIndex & /* parent */, int first, int last)
+{
+    if(!isFiltering()) {
+        beginInsertRows(QModelIndex(), first, last);
+    }
+}
+
+void PlaylistSearchModel::sourceRowsInserted(const QModelIndex & /* parent */, int first, int last)
+{
+    // entries are appended to the store, indexed ones keep their ids wherever the rows go
+    indexRows(first, last);
+
+    if(!isFiltering()) {
+        endInsertRows();
+        emit matchCountChanged();
+        return;
+    }
+
+    m_found.resize(m_source->items().size());
+
+    // rows after the new ones moved down, they are still shown at the same place
+    const int count = last - first + 1;
+    for(auto row = std::lower_bound(m_matches.begin(), m_matches.end(), first); row != m_matches.end(); ++row) {
+        *row += count;
+    }
+
+    updateMatches(first, last);
+    emit matchCountChanged();
+}
+
+void PlaylistSearchModel::sourceRowsAboutToBeRemoved(const QModelIndex & /* parent */, int first, int last)
+{
+    // from the last entry, the ones after a removed entry move up
+    m_removedItems.clear();
+    for(int row = first; row <= last; ++row) {
+        m_removedItems.append(m_source->itemIndex(row));
+    }
+    std::sort(m_removedItems.begin(), m_removedItems.end(), std::greater<int>());
+
+    if(!isFiltering()) {
+        beginRemoveRows(QModelIndex(), first, last);
+        return;
+    }
+
+    // only the shown ones of the rows go
+    m_removedFirst = static_cast<int>(std::lower_bound(m_matches.cbegin(), m_matches.cend(), first)
+                                      - m_matches.cbegin());
+    m_removedLast = static_cast<int>(std::upper_bound(m_matches.cbegin(), m_matches.cend(), last)
+                                     - m_matches.cbegin()) - 1;
+    if(m_removedFirst <= m_removedLast) {
+        beginRemoveRows(QModelIndex(), m_removedFirst, m_removedLast);
+    }
+}
+
+void PlaylistSearchModel::sourceRowsRemoved(const QModelIndex & /* parent */, int first, int last)
+{
+    for(int item : m_removedItems) {
+        m_index.removeItem(item);
+    }
+
+    if(!isFiltering()) {
+        endRemoveRows();
+        emit matchCountChanged();
+        return;
+    }
+
+    for(int item : m_removedItems) {
+        m_found.remove(item);
+    }
+
+    const bool shown = m_removedFirst <= m_removedLast;
+    if(shown) {
+        m_matches.remove(m_removedFirst, m_removedLast - m_removedFirst + 1);
+    }
+
+    // rows after the removed ones moved up
+    const int count = last - first + 1;
+    for(int match = m_removedFirst; match < m_matches.size(); ++match) {
+        m_matches[match] -= count;
+    }
+
+    if(shown) {
+        endRemoveRows();
+    }
+
+    fillMatches();
+    emit matchCountChanged();
+}
+
+void PlaylistSearchModel::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    // tags were read, their words replace the file name only ones
+    indexRows(topLeft.row(), bottomRight.row());
+
+    if(!isFiltering()) {
+        emit dataChanged(index(topLeft.row()), index(bottomRight.row()));
+        return;
+    }
+
+    updateMatches(topLeft.row(), bottomRight.row());
+
+    // forward the rows that are still shown
+    auto first = std::lower_bound(m_matches.cbegin(), m_matches.cend(), topLeft.row());
+    auto last = std::upper_bound(m_matches.cbegin(), m_matches.cend(), bottomRight.row());
+    if(first != last) {
+        emit dataChanged(index(static_cast<int>(first - m_matches.cbegin())),
+                         index(static_cast<int>(last - m_matches.cbegin()) - 1));
+    }
+
+    emit matchCountChanged();
+}
+
+void PlaylistSearchModel::sourceAboutToBeReset()
+{
+    beginResetModel();
+}
+
+void PlaylistSearchModel::sourceReset()
+{
+    reindex();
+    m_found = isFiltering() ? m_index.find(m_query) : PlaylistSearchIndex::Matches();
+    m_matches = findMatches();
+    endResetModel();
+
+    emit matchCountChanged();
+    emit currentIndexChanged(rowFromSource(m_source->currentIndex()));
+}
+
+void PlaylistSearchModel::sourceLayoutAboutToBeChanged()
+{
+    emit layoutAboutToBeChanged();
+
+    // entries stay, remember the ones shown
+    m_layoutIndexes = persistentIndexList();
+    m_layoutItems.clear();
+    for(const QModelIndex& index : m_layoutIndexes) {
+        m_layoutItems.append(m_source->itemIndex(sourceRow(index.row())));
+    }
+
+    m_matchedItems.clear();
+    for(int row : m_matches) {
+        m_matchedItems.append(m_source->itemIndex(row));
+    }
+}
+
+void PlaylistSearchModel::sourceLayoutChanged()
+{
+    if(isTruncated()) {
+        // other rows are first now, the ones no longer shown lose their indexes
+        m_matches = findMatches();
+    } else {
+        m_matches.clear();
+        for(int item : m_matchedItems) {
+            m_matches.append(m_source->rowOfItem(item));
+        }
+        std::sort(m_matches.begin(), m_matches.end());
+    }
+
+    QModelIndexList moved;
+    for(int item : m_layoutItems) {
+        moved.append(index(rowFromSource(m_source->rowOfItem(item))));
+    }
+    changePersistentIndexList(m_layoutIndexes, moved);
+
+    m_layoutIndexes.clear();
+    m_layoutItems.clear();
+    m_matchedItems.clear();
+
+    emit layoutChanged();
+    emit currentIndexChanged(rowFromSource(m_source->currentIndex()));
+}
+
+void PlaylistSearchModel::sourceCurrentIndexChanged(int index)
+{
+    emit currentIndexChanged(rowFromSource(index));
+}
+
+int PlaylistSearchModel::rowCount(const QModelIndex & /* parent */) const
+{
+    return isFiltering() ? m_matches.size() : m_source->rowCount();
+}
+
+QVariant PlaylistSearchModel::data(const QModelIndex &index, int role) const
+{
+    const int row = sourceRow(index.row());
+    if(!index.isValid() || row < 0) {
+        return QVariant();
+    }
+
+    if(role == SourceRowRole) {
+        return row;
+    }
+
+    return m_source->data(m_source->index(row), role);
+}
+
+QHash<int, QByteArray> PlaylistSearchModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = m_source->roleNames();
+    roles.insert(SourceRowRole, "sourceRow");
+
+    return roles;
+}
@@ -0,0 +1,96 @@
+#ifndef PLAYLISTSEARCHMODEL_H
+#define PLAYLISTSEARCHMODEL_H
+
+#include "playlistsearchindex.h"
+
+#include <QAbstractListModel>
+#include <QVector>
+
+class PlaylistItemModel;
+
+//! Playlist rows matching a search query, all of them while it is empty.
+//! Rows match if every word of the query starts a word of their title,
+//! artist, album or file name. The index follows the playlist as rows are
+//! added, tagged and removed, so a keystroke is a lookup, not a scan.
+//! A query matching very many entries shows the first rows of them until
+//! it gets longer, see truncated. Rows are inserted and removed as the
+//! playlist changes, sorting it only remaps the matches to their new rows.
+class PlaylistSearchModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(QString query READ query WRITE setQuery NOTIFY queryChanged)
+    Q_PROPERTY(int totalMatches READ totalMatches NOTIFY matchCountChanged)
+    Q_PROPERTY(bool truncated READ isTruncated NOTIFY matchCountChanged)
+
+    PlaylistItemModel* m_source;
+    PlaylistSearchIndex m_index;
+
+    QString m_query;
+    QStringList m_terms;
+    // entries matching the query
+    PlaylistSearchIndex::Matches m_found;
+    // playlist rows shown while searching, the first ones of m_found
+    QVector<int> m_matches;
+
+    // entries of rows while the playlist changes
+    QVector<int> m_removedItems;
+    int m_removedFirst;
+    int m_removedLast;
+    QModelIndexList m_layoutIndexes;
+    QVector<int> m_layoutItems;
+    QVector<int> m_matchedItems;
+
+    bool isFiltering() const;
+    QStringList fields(int item) const;
+    void indexItem(int item);
+    void indexRows(int first, int last);
+    void reindex();
+    QVector<int> findMatches() const;
+    void updateMatches(int first, int last);
+    void showMatches(QVector<int> rows);
+    void hideMatches(const QVector<int>& rows);
+    void fillMatches();
+
+private slots:
+    void sourceRowsAboutToBeInserted(const QModelIndex& parent, int first, int last);
+    void sourceRowsInserted(const QModelIndex& parent, int first, int last);
+    void sourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void sourceRowsRemoved(const QModelIndex& parent, int first, int last);
+    void sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void sourceAboutToBeReset();
+    void sourceReset();
+    void sourceLayoutAboutToBeChanged();
+    void sourceLayoutChanged();
+    void sourceCurrentIndexChanged(int index);
+
+public:
+    enum SearchRoles {
+        //! Row in the playlist, for actions on it.
+        SourceRowRole = Qt::UserRole + 100
+    };
+
+    explicit PlaylistSearchModel(PlaylistItemModel* source, QObject* parent = nullptr);
+
+    QString query() const;
+    void setQuery(const QString& query);
+
+    //! Rows matching the query, shown or not.
+    int totalMatches() const;
+    //! Whether only the first of many matching rows are shown.
+    bool isTruncated() const;
+
+    Q_INVOKABLE int sourceRow(int row) const;
+    Q_INVOKABLE int rowFromSource(int sourceRow) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+signals:
+    void queryChanged();
+    void matchCountChanged();
+    //! Current playlist row as a row of this model, -1 if it is filtered out.
+    void currentIndexChanged(int index);
+};
+
+#endif // PLAYLISTSEARCHMODEL_H
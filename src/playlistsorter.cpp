@@ -0,0 +1,195 @@
+#include "playlistsorter.h"
+#include "playliststore.h"
+
+#include "ctpl_stl.h"
+
+#include <QCollator>
+#include <QCollatorSortKey>
+#include <QThread>
+
+#include <algorithm>
+#include <future>
+#include <vector>
+
+// not worth the threads below this
+constexpr int min_parallel_size = 4096;
+
+static QCollator playlistCollator()
+{
+    // track 2 before track 10
+    QCollator collator;
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    collator.setNumericMode(true);
+
+    return collator;
+}
+
+// threads are started once and wait between sorts
+static ctpl::thread_pool& sortPool()
+{
+    static ctpl::thread_pool pool(std::max(1, QThread::idealThreadCount()));
+
+    return pool;
+}
+
+static void waitAll(std::vector<std::future<void>>& jobs)
+{
+    for(auto& job : jobs) {
+        job.get();
+    }
+    jobs.clear();
+}
+
+// rank of every interned string in collation order
+static std::vector<quint32> stringRanks(const PlaylistStore& store)
+{
+    std::vector<quint32> ids(static_cast<size_t>(store.stringCount()));
+    for(size_t id = 0; id < ids.size(); ++id) {
+        ids[id] = static_cast<quint32>(id);
+    }
+
+    const QCollator collator = playlistCollator();
+    std::sort(ids.begin(), ids.end(), [&](quint32 a, quint32 b) {
+        return collator.compare(store.string(a), store.string(b)) < 0;
+    });
+
+    std::vector<quint32> ranks(ids.size());
+    for(size_t rank = 0; rank < ids.size(); ++rank) {
+        ranks[ids[rank]] = static_cast<quint32>(rank);
+    }
+
+    return ranks;
+}
+
+// collation keys of a text of every entry, computed in parallel
+template <typename Text>
+static std::vector<QCollatorSortKey> sortKeys(int size, const Text& text, ctpl::thread_pool& pool)
+{
+    const int chunk = std::max(min_parallel_size, (size + pool.size() - 1) / pool.size());
+
+    std::vector<std::vector<QCollatorSortKey>> chunks;
+    std::vector<std::future<void>> jobs;
+
+    for(int first = 0; first < size; first += chunk) {
+        chunks.emplace_back();
+    }
+
+    for(int first = 0, i = 0; first < size; first += chunk, ++i) {
+        jobs.push_back(pool.push([&, first, i](int /* thread_id */) {
+            // collators are not shared between threads
+            const QCollator collator = playlistCollator();
+            const int last = std::min(first + chunk, size);
+
+            auto& keys = chunks[static_cast<size_t>(i)];
+            keys.reserve(static_cast<size_t>(last - first));
+            for(int index = first; index < last; ++index) {
+                keys.push_back(collator.sortKey(text(index)));
+            }
+        }));
+    }
+    waitAll(jobs);
+
+    std::vector<QCollatorSortKey> keys;
+    keys.reserve(static_cast<size_t>(size));
+    for(auto& part : chunks) {
+        std::move(part.begin(), part.end(), std::back_inserter(keys));
+    }
+
+    return keys;
+}
+
+// stable sort of chunks in parallel, then merges of pairs of them
+template <typename Less>
+static void parallelStableSort(std::vector<int>& order, const Less& less, ctpl::thread_pool& pool)
+{
+    const int size = static_cast<int>(order.size());
+    const int chunk = std::max(min_parallel_size, (size + pool.size() - 1) / pool.size());
+    const auto begin = order.begin();
+
+    std::vector<std::future<void>> jobs;
+
+    for(int first = 0; first < size; first += chunk) {
+        jobs.push_back(pool.push([&, first](int /* thread_id */) {
+            std::stable_sort(begin + first, begin + std::min(first + chunk, size), less);
+        }));
+    }
+    waitAll(jobs);
+
+    for(int width = chunk; width < size; width *= 2) {
+        for(int first = 0; first + width < size; first += 2 * width) {
+            jobs.push_back(pool.push([&, first, width](int /* thread_id */) {
+                std::inplace_merge(begin + first, begin + first + width,
+                                   begin + std::min(first + 2 * width, size), less);
+            }));
+        }
+        waitAll(jobs);
+    }
+}
+
+QVector<int> PlaylistSorter::sort(const PlaylistStore &store, const QVector<int> &order,
+                                  SortKey key, Qt::SortOrder sortOrder)
+{
+    const int size = store.size();
+    ctpl::thread_pool& pool = sortPool();
+
+    // integer key first, collation key of a text for ties if there is one
+    std::vector<quint64> primary(static_cast<size_t>(size), 0);
+    std::vector<QCollatorSortKey> secondary;
+
+    switch(key) {
+    case SortByArtist:
+    case SortByAlbum: {
+        const std::vector<quint32> ranks = stringRanks(store);
+        for(int i = 0; i < size; ++i) {
+            const quint64 artist = ranks[store.artistId(i)];
+            const quint64 album = ranks[store.albumId(i)];
+            primary[static_cast<size_t>(i)] = key == SortByArtist ? artist << 32 | album : album << 32 | artist;
+        }
+        break;
+    }
+    case SortByTitle:
+        secondary = sortKeys(size, [&store](int i) {
+            const QString song = store.song(i);
+            return song.isEmpty() ? store.fileName(i) : song;
+        }, pool);
+        break;
+    case SortByDuration:
+        for(int i = 0; i < size; ++i) {
+            primary[static_cast<size_t>(i)] = static_cast<quint64>(std::max<qint64>(store.duration(i), 0));
+        }
+        break;
+    case SortByPath: {
+        const std::vector<quint32> ranks = stringRanks(store);
+        for(int i = 0; i < size; ++i) {
+            primary[static_cast<size_t>(i)] = ranks[store.directoryId(i)];
+        }
+        secondary = sortKeys(size, [&store](int i) { return store.fileName(i); }, pool);
+        break;
+    }
+    case SortByAdded:
+        for(int i = 0; i < size; ++i) {
+            primary[static_cast<size_t>(i)] = static_cast<quint64>(i);
+        }
+        break;
+    }
+
+    const auto less = [&](int a, int b) {
+        if(primary[a] != primary[b]) {
+            return primary[a] < primary[b];
+        }
+        return !secondary.empty() && secondary[a].compare(secondary[b]) < 0;
+    };
+
+    std::vector<int> sorted(order.cbegin(), order.cend());
+    if(sortOrder == Qt::AscendingOrder) {
+        parallelStableSort(sorted, less, pool);
+    } else {
+        parallelStableSort(sorted, [&less](int a, int b) { return less(b, a); }, pool);
+    }
+
+    QVector<int> result;
+    result.reserve(size);
+    std::copy(sorted.cbegin(), sorted.cend(), std::back_inserter(result));
+
+    return result;
+}
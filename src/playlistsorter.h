@@ -0,0 +1,36 @@
+#ifndef PLAYLISTSORTER_H
+#define PLAYLISTSORTER_H
+
+#include <QObject>
+#include <QVector>
+
+class PlaylistStore;
+
+//! Sorts playlist entries without moving them, the result is a new order of their indices.
+//! Keys are computed once per entry, or once per interned string for artists,
+//! albums and directories, then the order is sorted in chunks on a thread pool
+//! shared by all sorts and the chunks are merged. The sort is stable, entries with equal keys keep
+//! their order, so sorts can be chained.
+class PlaylistSorter
+{
+    Q_GADGET
+
+public:
+    enum SortKey {
+        //! Artist, then album.
+        SortByArtist,
+        //! Album, then artist.
+        SortByAlbum,
+        //! Title, the file name for files without one.
+        SortByTitle,
+        SortByDuration,
+        SortByPath,
+        SortByAdded
+    };
+    Q_ENUM(SortKey)
+
+    static QVector<int> sort(const PlaylistStore& store, const QVector<int>& order,
+                             SortKey key, Qt::SortOrder sortOrder);
+};
+
+#endif // PLAYLISTSORTER_H
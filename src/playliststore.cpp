@@ -0,0 +1,285 @@
+#include "playliststore.h"
+
+#include <algorithm>
+#include <cstring>
+
+// titles and file names are packed anew when this share of their buffer is unused
+constexpr int text_compact_ratio = 2;
+constexpr int min_text_compact = 1 << 16;
+
+// heap header of a QString, on 64-bit systems
+constexpr qint64 string_header_size = 24;
+
+PlaylistStore::PlaylistStore()
+{
+    clear();
+}
+
+quint32 PlaylistStore::intern(const QString &string)
+{
+    auto id = m_stringIds.constFind(string);
+    if(id != m_stringIds.constEnd()) {
+        return *id;
+    }
+
+    const quint32 newId = static_cast<quint32>(m_strings.size());
+    m_strings.append(string);
+    m_stringIds.insert(string, newId);
+
+    return newId;
+}
+
+PlaylistStore::Text PlaylistStore::pack(const QString &string)
+{
+    const QByteArray bytes = string.toUtf8();
+    const Text text{static_cast<quint32>(m_text.size()), static_cast<quint32>(bytes.size())};
+
+    m_text.append(bytes);
+
+    return text;
+}
+
+PlaylistStore::Text PlaylistStore::repack(Text text, const QString &string)
+{
+    const QByteArray bytes = string.toUtf8();
+
+    // a title read from tags is usually no longer than the one it replaces
+    if(static_cast<quint32>(bytes.size()) <= text.size) {
+        std::memcpy(m_text.data() + text.offset, bytes.constData(), static_cast<size_t>(bytes.size()));
+        m_deadBytes += text.size - static_cast<quint32>(bytes.size());
+        return Text{text.offset, static_cast<quint32>(bytes.size())};
+    }
+
+    m_deadBytes += text.size;
+    const Text packed{static_cast<quint32>(m_text.size()), static_cast<quint32>(bytes.size())};
+    m_text.append(bytes);
+
+    return packed;
+}
+
+QString PlaylistStore::unpack(Text text) const
+{
+    return QString::fromUtf8(m_text.constData() + text.offset, static_cast<int>(text.size));
+}
+
+int PlaylistStore::size() const
+{
+    return m_durations.size();
+}
+
+void PlaylistStore::reserve(int size)
+{
+    m_directories.reserve(size);
+    m_fileNames.reserve(size);
+    m_songs.reserve(size);
+    m_artists.reserve(size);
+    m_albums.reserve(size);
+    m_covers.reserve(size);
+    m_durations.reserve(size);
+}
+
+void PlaylistStore::append(const AudioTagInfo &item)
+{
+    // paths are absolute and always use '/'
+    const int separator = item.path.lastIndexOf('/');
+
+    m_directories.append(intern(item.path.left(std::max(separator, 0))));
+    m_fileNames.append(pack(item.path.mid(separator + 1)));
+    m_songs.append(Text{0, 0});
+    m_artists.append(0);
+    m_albums.append(0);
+    m_covers.append(0);
+    m_durations.append(0);
+
+    setTags(size() - 1, item);
+}
+
+void PlaylistStore::setTags(int index, const AudioTagInfo &item)
+{
+    // rows are added before their tags are read, only titles take new space
+    m_songs[index] = repack(m_songs.at(index), item.song);
+    m_artists[index] = intern(item.artist);
+    m_albums[index] = intern(item.album);
+    m_covers[index] = intern(item.coverUrl);
+    m_durations[index] = item.duration;
+
+    compactIfWasteful();
+}
+
+void PlaylistStore::remove(int index, int count)
+{
+    for(int i = index; i < index + count; ++i) {
+        m_deadBytes += m_fileNames.at(i).size + m_songs.at(i).size;
+    }
+
+    m_directories.remove(index, count);
+    m_fileNames.remove(index, count);
+    m_songs.remove(index, count);
+    m_artists.remove(index, count);
+    m_albums.remove(index, count);
+    m_covers.remove(index, count);
+    m_durations.remove(index, count);
+
+    compactIfWasteful();
+}
+
+void PlaylistStore::compactIfWasteful()
+{
+    if(m_deadBytes >= std::max<qint64>(min_text_compact, m_text.size() / text_compact_ratio)) {
+        compact();
+    }
+}
+
+void PlaylistStore::compact()
+{
+    QByteArray text;
+    text.reserve(static_cast<int>(m_text.size() - m_deadBytes));
+
+    for(QVector<Text>* column : { &m_fileNames, &m_songs }) {
+        for(Text& entry : *column) {
+            const quint32 offset = static_cast<quint32>(text.size());
+            text.append(m_text.constData() + entry.offset, static_cast<int>(entry.size));
+            entry.offset = offset;
+        }
+    }
+
+    m_text.swap(text);
+    m_deadBytes = 0;
+
+    // interned strings still in use keep their order, the empty one stays 0
+    QVector<quint32> ids(m_strings.size(), 0);
+    QVector<bool> used(m_strings.size(), false);
+    used[0] = true;
+    for(const QVector<quint32>* column : { &m_directories, &m_artists, &m_albums, &m_covers }) {
+        for(quint32 id : *column) {
+            used[id] = true;
+        }
+    }
+
+    QVector<QString> strings;
+    m_stringIds.clear();
+    for(int id = 0; id < m_strings.size(); ++id) {
+        if(used.at(id)) {
+            ids[id] = static_cast<quint32>(strings.size());
+            m_stringIds.insert(m_strings.at(id), ids.at(id));
+            strings.append(m_strings.at(id));
+        }
+    }
+    m_strings.swap(strings);
+
+    for(QVector<quint32>* column : { &m_directories, &m_artists, &m_albums, &m_covers }) {
+        for(quint32& id : *column) {
+            id = ids.at(id);
+        }
+    }
+}
+
+void PlaylistStore::clear()
+{
+    m_strings.clear();
+    m_stringIds.clear();
+    m_text.clear();
+    m_deadBytes = 0;
+
+    m_directories.clear();
+    m_fileNames.clear();
+    m_songs.clear();
+    m_artists.clear();
+    m_albums.clear();
+    m_covers.clear();
+    m_durations.clear();
+
+    intern(QString());
+}
+
+QString PlaylistStore::path(int index) const
+{
+    return m_strings.at(m_directories.at(index)) + '/' + fileName(index);
+}
+
+QString PlaylistStore::fileName(int index) const
+{
+    return unpack(m_fileNames.at(index));
+}
+
+QString PlaylistStore::song(int index) const
+{
+    return unpack(m_songs.at(index));
+}
+
+const QString &PlaylistStore::artist(int index) const
+{
+    return m_strings.at(m_artists.at(index));
+}
+
+const QString &PlaylistStore::album(int index) const
+{
+    return m_strings.at(m_albums.at(index));
+}
+
+const QString &PlaylistStore::coverUrl(int index) const
+{
+    return m_strings.at(m_covers.at(index));
+}
+
+qint64 PlaylistStore::duration(int index) const
+{
+    return m_durations.at(index);
+}
+
+AudioTagInfo PlaylistStore::at(int index) const
+{
+    AudioTagInfo item;
+    item.path = path(index);
+    item.fileName = fileName(index);
+    item.song = song(index);
+    item.artist = artist(index);
+    item.album = album(index);
+    item.coverUrl = coverUrl(index);
+    item.duration = duration(index);
+
+    return item;
+}
+
+int PlaylistStore::stringCount() const
+{
+    return m_strings.size();
+}
+
+const QString &PlaylistStore::string(quint32 id) const
+{
+    return m_strings.at(id);
+}
+
+quint32 PlaylistStore::directoryId(int index) const
+{
+    return m_directories.at(index);
+}
+
+quint32 PlaylistStore::artistId(int index) const
+{
+    return m_artists.at(index);
+}
+
+quint32 PlaylistStore::albumId(int index) const
+{
+    return m_albums.at(index);
+}
+
+qint64 PlaylistStore::memoryUsage() const
+{
+    // interned strings are shared by the list and the hash, their data is counted once
+    qint64 strings = 0;
+    for(const QString& string : m_strings) {
+        strings += static_cast<qint64>(sizeof(QString)) + string_header_size + (string.capacity() + 1) * 2;
+    }
+    const qint64 hash = m_stringIds.capacity() * static_cast<qint64>(sizeof(void*))
+            + m_stringIds.size() * static_cast<qint64>(sizeof(void*) + sizeof(uint) + sizeof(QString) + sizeof(quint32));
+
+    const qint64 columns = (m_directories.capacity() + m_artists.capacity() + m_albums.capacity()
+                            + m_covers.capacity()) * static_cast<qint64>(sizeof(quint32))
+            + (m_fileNames.capacity() + m_songs.capacity()) * static_cast<qint64>(sizeof(Text))
+            + m_durations.capacity() * static_cast<qint64>(sizeof(qint64));
+
+    return m_text.capacity() + strings + hash + columns;
+}
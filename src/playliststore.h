@@ -0,0 +1,84 @@
+#ifndef PLAYLISTSTORE_H
+#define PLAYLISTSTORE_H
+
+#include "audiotaginfo.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+//! Playlist entries stored as columns, compact enough for million entry playlists.
+//! Directories, artists, albums and covers repeat across a collection and
+//! are interned, an entry only holds their ids. Titles and file names are
+//! packed as UTF-8 into one buffer. Paths are put back together from the
+//! directory and the file name on access.
+//! Titles and file names are decoded on access and returned by value,
+//! a view into the buffer would need it in UTF-16 at twice the size, and
+//! model roles hand out a QString anyway. Interned ones are returned by reference.
+//! Space of retagged and removed entries is reused or compacted away
+//! together with interned strings no entry uses anymore.
+class PlaylistStore
+{
+    struct Text {
+        quint32 offset;
+        quint32 size;
+    };
+
+    // every distinct string once, id 0 is the empty string
+    QVector<QString> m_strings;
+    QHash<QString, quint32> m_stringIds;
+    QByteArray m_text;
+    // bytes of m_text no entry points to
+    qint64 m_deadBytes;
+
+    QVector<quint32> m_directories;
+    QVector<Text> m_fileNames;
+    QVector<Text> m_songs;
+    QVector<quint32> m_artists;
+    QVector<quint32> m_albums;
+    QVector<quint32> m_covers;
+    QVector<qint64> m_durations;
+
+    quint32 intern(const QString& string);
+    Text pack(const QString& string);
+    Text repack(Text text, const QString& string);
+    QString unpack(Text text) const;
+    void compactIfWasteful();
+    void compact();
+
+public:
+    PlaylistStore();
+
+    int size() const;
+    void reserve(int size);
+
+    void append(const AudioTagInfo& item);
+    //! Replace the tags of an entry, its path stays.
+    void setTags(int index, const AudioTagInfo& item);
+    void remove(int index, int count);
+    void clear();
+
+    QString path(int index) const;
+    QString fileName(int index) const;
+    QString song(int index) const;
+    const QString& artist(int index) const;
+    const QString& album(int index) const;
+    const QString& coverUrl(int index) const;
+    qint64 duration(int index) const;
+
+    //! Copy of the whole entry.
+    AudioTagInfo at(int index) const;
+
+    //! Interned strings, e.g. to rank them once for sorting.
+    int stringCount() const;
+    const QString& string(quint32 id) const;
+    quint32 directoryId(int index) const;
+    quint32 artistId(int index) const;
+    quint32 albumId(int index) const;
+
+    //! Bytes held by all entries, buffers and interned strings, about.
+    qint64 memoryUsage() const;
+};
+
+#endif // PLAYLISTSTORE_H
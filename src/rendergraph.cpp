@@ -0,0 +1,146 @@
+#include "rendergraph.h"
+#include "shadercache.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+
+// offscreen passes render at a scale of the viewport in this range
+constexpr qreal min_pass_scale = 1. / 16.;
+constexpr qreal max_pass_scale = 1.;
+
+// uniforms every pass gets from the renderer, a pass of that name would shadow them
+static const QStringList reserved_names = {
+    "fftwave", "history", "history_head", "history_size", "resolution", "time", "sample_size",
+    "rms", "peak", "centroid", "flux", "onset", "bands", "bands_low", "bands_mid", "bands_high",
+    "beat_phase", "bpm"
+};
+
+RenderGraph::RenderGraph()
+    : m_feedback(false)
+{
+}
+
+RenderGraph RenderGraph::load(const QString &shaderPath)
+{
+    RenderGraph graph;
+
+    const QString sidecar = sidecarPath(shaderPath);
+    if(QFileInfo::exists(sidecar) && !graph.parse(sidecar, shaderPath)) {
+        graph = RenderGraph();
+    }
+
+    if(graph.m_passes.isEmpty()) {
+        graph.m_passes << Pass{QString(), ShaderCache::key(shaderPath), max_pass_scale, {}, false};
+    }
+
+    return graph;
+}
+
+QString RenderGraph::sidecarPath(const QString &shaderPath)
+{
+    const QFileInfo info(shaderPath);
+    return info.absoluteDir().filePath(info.completeBaseName() + ".json");
+}
+
+const QVector<RenderGraph::Pass> &RenderGraph::passes() const
+{
+    return m_passes;
+}
+
+int RenderGraph::passIndex(const QString &name) const
+{
+    if(name.isEmpty()) {
+        return -1;
+    }
+
+    for(int i = 0; i < m_passes.size(); ++i) {
+        if(m_passes.at(i).name == name) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool RenderGraph::hasFeedback() const
+{
+    return m_feedback;
+}
+
+bool RenderGraph::parse(const QString &sidecar, const QString &shaderPath)
+{
+    QFile file(sidecar);
+    if(!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Render graph: could not read" << sidecar;
+        return false;
+    }
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if(error.error != QJsonParseError::NoError || !document.isObject()) {
+        qWarning() << "Render graph:" << sidecar << error.errorString();
+        return false;
+    }
+
+    // names become sampler uniforms
+    static const QRegularExpression identifier("^[A-Za-z_][A-Za-z0-9_]*$");
+
+    const QDir dir = QFileInfo(sidecar).absoluteDir();
+    const QJsonObject root = document.object();
+
+    for(const QJsonValue& value : root.value("passes").toArray()) {
+        const QJsonObject object = value.toObject();
+
+        Pass pass;
+        pass.name = object.value("name").toString();
+        pass.shader = object.value("shader").toString();
+        pass.scale = qBound(min_pass_scale, object.value("scale").toDouble(max_pass_scale), max_pass_scale);
+        pass.inputs = object.value("inputs").toVariant().toStringList();
+        pass.feedback = false;
+
+        if(!identifier.match(pass.name).hasMatch() || passIndex(pass.name) != -1 || pass.shader.isEmpty()) {
+            qWarning() << "Render graph:" << sidecar << "pass needs a unique name and a shader";
+            return false;
+        }
+
+        if(reserved_names.contains(pass.name)) {
+            qWarning() << "Render graph:" << sidecar << "pass name" << pass.name << "is a built-in uniform";
+            return false;
+        }
+
+        pass.shader = ShaderCache::key(dir.filePath(pass.shader));
+        m_passes << pass;
+    }
+
+    // the shader itself renders to the screen
+    m_passes << Pass{QString(), QString(), max_pass_scale, {}, false};
+    m_passes.last().shader = ShaderCache::key(shaderPath);
+    m_passes.last().inputs = root.value("inputs").toVariant().toStringList();
+
+    for(int i = 0; i < m_passes.size(); ++i) {
+        for(const QString& input : m_passes.at(i).inputs) {
+            const int source = passIndex(input);
+            if(source == -1) {
+                qWarning() << "Render graph:" << sidecar << "unknown input" << input;
+                return false;
+            }
+
+            // not rendered yet this frame, read the last one
+            if(source >= i) {
+                m_passes[source].feedback = true;
+            }
+        }
+    }
+
+    for(const Pass& pass : m_passes) {
+        m_feedback = m_feedback || pass.feedback;
+    }
+
+    return true;
+}
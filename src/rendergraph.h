@@ -0,0 +1,61 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+//! Passes of a visualisation, read from an optional sidecar JSON
+//! next to its shader, e.g. trails.json for trails.glsl:
+//!
+//!     {
+//!         "passes": [
+//!             { "name": "trail", "shader": "passes/trail.glsl", "scale": 0.5, "inputs": ["trail"] },
+//!             { "name": "glow", "shader": "passes/blur.glsl", "scale": 0.25, "inputs": ["trail"] }
+//!         ],
+//!         "inputs": ["trail", "glow"]
+//!     }
+//!
+//! Passes render in order into their own buffers at a scale of the
+//! viewport, then the shader itself renders to the screen. Inputs are
+//! bound as sampler2D uniforms named after the pass, so names of built-in
+//! uniforms such as fftwave or time are rejected. A pass that reads
+//! itself or a later pass sees its output of the previous frame,
+//! it gets a second buffer to ping-pong with.
+//! Without a sidecar the graph is the shader alone.
+class RenderGraph
+{
+public:
+    struct Pass {
+        QString name;
+        //! Absolute shader path.
+        QString shader;
+        qreal scale;
+        QStringList inputs;
+        bool feedback;
+    };
+
+    RenderGraph();
+
+    //! Graph of a shader, falls back to the shader alone if the sidecar is invalid.
+    static RenderGraph load(const QString& shaderPath);
+
+    static QString sidecarPath(const QString& shaderPath);
+
+    //! Offscreen passes first, the shader itself last.
+    const QVector<Pass>& passes() const;
+
+    //! Index of a named offscreen pass, -1 if there is none.
+    int passIndex(const QString& name) const;
+
+    //! True if a pass reads a previous frame, the graph has to render continuously.
+    bool hasFeedback() const;
+
+private:
+    QVector<Pass> m_passes;
+    bool m_feedback;
+
+    bool parse(const QString& sidecar, const QString& shaderPath);
+};
+
+#endif // RENDERGRAPH_H
@@ -0,0 +1,170 @@
+#include "resolutioncontroller.h"
+
+#include <algorithm>
+
+constexpr qreal min_scale = 0.25;
+constexpr qreal max_scale = 1.0;
+constexpr qreal step_down = 0.85;
+constexpr qreal step_up = 1.1;
+constexpr qreal frame_time_smoothing = 0.9;
+// drop the tier rather than scale below this
+constexpr qreal tier_scale = 0.5;
+
+// late by this much before scaling down, vsync jitter stays below it
+constexpr qreal late_ratio = 1.1;
+// on time by this much before scaling up
+constexpr qreal on_time_ratio = 1.05;
+
+// frames to settle after a change
+constexpr int settle_frames = 30;
+// frames on time before trying a higher scale
+constexpr int headroom_frames = 120;
+// frames a failed scale stays a ceiling
+constexpr int ceiling_frames = 1800;
+
+ResolutionController::ResolutionController()
+    : m_scale(max_scale),
+      m_ceiling(max_scale),
+      m_tier(0),
+      m_maxTier(0),
+      m_tierCeiling(0),
+      m_frameTime(0),
+      m_targetFrameTime(1000. / 60.),
+      m_enabled(true),
+      m_framesSinceChange(0),
+      m_framesSinceCeiling(0),
+      m_framesSinceTierCeiling(0),
+      m_lastChangeWasUp(false),
+      m_lastChangeWasTierUp(false)
+{
+}
+
+void ResolutionController::setTargetFrameRate(qreal fps)
+{
+    if(fps > 0) {
+        m_targetFrameTime = 1000. / fps;
+        m_ceiling = max_scale;
+        m_tierCeiling = m_maxTier;
+    }
+}
+
+qreal ResolutionController::targetFrameRate() const
+{
+    return 1000. / m_targetFrameTime;
+}
+
+void ResolutionController::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+
+    if(!m_enabled) {
+        m_scale = max_scale;
+        m_tier = m_maxTier;
+    }
+}
+
+void ResolutionController::setMaxTier(int tier)
+{
+    m_maxTier = std::max(0, tier);
+    m_tier = m_maxTier;
+    m_tierCeiling = m_maxTier;
+}
+
+bool ResolutionController::isEnabled() const
+{
+    return m_enabled;
+}
+
+bool ResolutionController::addFrame(qreal frameTimeMs)
+{
+    m_frameTime = m_frameTime > 0
+            ? frame_time_smoothing * m_frameTime + (1 - frame_time_smoothing) * frameTimeMs
+            : frameTimeMs;
+
+    ++m_framesSinceChange;
+
+    if(++m_framesSinceCeiling > ceiling_frames) {
+        m_ceiling = max_scale;
+    }
+
+    if(++m_framesSinceTierCeiling > ceiling_frames) {
+        m_tierCeiling = m_maxTier;
+    }
+
+    if(!m_enabled || m_framesSinceChange < settle_frames) {
+        return false;
+    }
+
+    const qreal oldScale = m_scale;
+    const int oldTier = m_tier;
+
+    if(m_frameTime > m_targetFrameTime * late_ratio) {
+        const bool justChanged = m_framesSinceChange < headroom_frames;
+
+        if(m_lastChangeWasTierUp && justChanged) {
+            // the tier step up did not fit, go back and remember it
+            --m_tier;
+            m_tierCeiling = m_tier;
+            m_framesSinceTierCeiling = 0;
+        } else if(m_tier > 0 && m_scale * step_down < tier_scale) {
+            // a cheaper shader looks better than a blurry one
+            --m_tier;
+        } else if(m_scale > min_scale) {
+            // the step up did not fit, remember it
+            if(m_lastChangeWasUp && justChanged) {
+                m_ceiling = m_scale;
+                m_framesSinceCeiling = 0;
+            }
+
+            m_scale = std::max(min_scale, m_scale * step_down);
+        }
+
+        m_lastChangeWasUp = false;
+        m_lastChangeWasTierUp = false;
+    } else if(m_frameTime < m_targetFrameTime * on_time_ratio
+              && m_framesSinceChange >= headroom_frames) {
+        if(m_scale < m_ceiling) {
+            // stay a step below a scale that was too slow
+            const qreal limit = m_ceiling < max_scale ? m_ceiling * step_down : max_scale;
+
+            m_scale = std::max(oldScale, std::min(limit, m_scale * step_up));
+            m_lastChangeWasUp = true;
+            m_lastChangeWasTierUp = false;
+        } else if(m_scale >= max_scale && m_tier < m_tierCeiling) {
+            // full resolution has headroom, try the next tier
+            ++m_tier;
+            m_lastChangeWasUp = false;
+            m_lastChangeWasTierUp = true;
+        }
+    }
+
+    if(qFuzzyCompare(m_scale, oldScale) && m_tier == oldTier) {
+        m_scale = oldScale;
+        return false;
+    }
+
+    m_framesSinceChange = 0;
+    m_frameTime = 0;
+    return true;
+}
+
+void ResolutionController::reset()
+{
+    m_frameTime = 0;
+    m_framesSinceChange = 0;
+}
+
+qreal ResolutionController::scale() const
+{
+    return m_scale;
+}
+
+int ResolutionController::tier() const
+{
+    return m_tier;
+}
+
+qreal ResolutionController::frameTime() const
+{
+    return m_frameTime;
+}
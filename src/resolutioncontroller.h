@@ -0,0 +1,53 @@
+#ifndef RESOLUTIONCONTROLLER_H
+#define RESOLUTIONCONTROLLER_H
+
+#include <QtGlobal>
+
+//! Picks a render scale and a shader quality tier that hold a target frame rate.
+//! Scale drops quickly when frames are late and creeps back up while
+//! there is headroom. Rather than scaling below half resolution the tier
+//! drops, and it goes back up once full resolution has headroom.
+//! A scale or tier that was just too slow becomes a ceiling
+//! for a while, so the controller does not keep probing it.
+class ResolutionController
+{
+    qreal m_scale;
+    qreal m_ceiling;
+    int m_tier;
+    int m_maxTier;
+    int m_tierCeiling;
+    qreal m_frameTime;
+    qreal m_targetFrameTime;
+    bool m_enabled;
+
+    int m_framesSinceChange;
+    int m_framesSinceCeiling;
+    int m_framesSinceTierCeiling;
+    bool m_lastChangeWasUp;
+    bool m_lastChangeWasTierUp;
+
+public:
+    ResolutionController();
+
+    void setTargetFrameRate(qreal fps);
+    qreal targetFrameRate() const;
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    //! Highest tier, the controller starts there.
+    void setMaxTier(int tier);
+
+    //! Feed the time between two continuously rendered frames.
+    //! Returns true if the scale or the tier changed.
+    bool addFrame(qreal frameTimeMs);
+
+    //! Forget the frame time after an idle gap.
+    void reset();
+
+    qreal scale() const;
+    int tier() const;
+    qreal frameTime() const;
+};
+
+#endif // RESOLUTIONCONTROLLER_H
@@ -0,0 +1,306 @@
+#include "shadercache.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <QWaitCondition>
+
+constexpr auto vertex_shader_source =
+        "attribute highp vec4 vertices;"
+        "void main() {"
+        "    gl_Position = vertices;"
+        "}";
+
+//! Compiles queued shaders in its own context that shares with the scene graph.
+class ShaderCache::CompileThread : public QThread
+{
+    ShaderCache* m_cache;
+    QOffscreenSurface* m_surface;
+
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    bool m_stop;
+
+public:
+    CompileThread(ShaderCache* cache, QOffscreenSurface* surface)
+        : m_cache(cache), m_surface(surface), m_stop(false)
+    {
+    }
+
+    void wake()
+    {
+        QMutexLocker lock(&m_mutex);
+        m_wake.wakeOne();
+    }
+
+    void stop()
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stop = true;
+        m_wake.wakeOne();
+    }
+
+protected:
+    void run() override
+    {
+        QOpenGLContext context;
+        context.setShareContext(QOpenGLContext::globalShareContext());
+        context.setFormat(m_surface->format());
+
+        if(!context.create() || !context.makeCurrent(m_surface)) {
+            qWarning() << "Shader cache: could not create a shared OpenGL context";
+            m_cache->m_running = false;
+            return;
+        }
+
+        forever {
+            for(const QString& path : m_cache->takeQueue()) {
+                QFile file(path);
+                if(!file.open(QIODevice::ReadOnly)) {
+                    qWarning() << "Shader cache: could not read" << path;
+                    m_cache->markFailed(path);
+                    continue;
+                }
+
+                const QByteArray source = file.readAll();
+
+                QElapsedTimer timer;
+                timer.start();
+
+                // every tier variant, so a tier change only links from the binary cache
+                const int variants = ShaderCache::hasTiers(source) ? QualityTierCount : 1;
+                bool compiled = true;
+
+                for(int tier = variants - 1; tier >= 0 && compiled; --tier) {
+                    QOpenGLShaderProgram program;
+                    compiled = ShaderCache::buildProgram(program, ShaderCache::variantSource(source, tier));
+                    if(!compiled) {
+                        qWarning() << "Shader cache: failed" << path << "tier" << tier << program.log();
+                    }
+                }
+
+                if(compiled) {
+                    qDebug() << "Shader cache: compiled" << path << variants << "variants in" << timer.elapsed() << "ms";
+                    m_cache->markCompiled(path, source);
+                } else {
+                    m_cache->markFailed(path);
+                }
+            }
+
+            QMutexLocker lock(&m_mutex);
+            if(m_stop) {
+                break;
+            }
+            if(!m_cache->hasQueued()) {
+                m_wake.wait(&m_mutex);
+            }
+            if(m_stop) {
+                break;
+            }
+        }
+
+        context.doneCurrent();
+    }
+};
+
+ShaderCache::ShaderCache(const QString &shaderDir, QObject *parent)
+    : QObject(parent),
+      m_shaderDir(QDir(shaderDir).absolutePath()),
+      m_running(false),
+      m_surface(nullptr),
+      m_thread(nullptr)
+{
+    // render graph passes live in subdirectories
+    QDirIterator it(m_shaderDir, {"*.glsl"}, QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext()) {
+        m_shaders << QFileInfo(it.next()).absoluteFilePath();
+    }
+    m_shaders.sort();
+}
+
+ShaderCache::~ShaderCache()
+{
+    if(m_thread) {
+        m_thread->stop();
+        m_thread->wait();
+        delete m_thread;
+    }
+
+    delete m_surface;
+}
+
+QString ShaderCache::key(const QString &path)
+{
+    return QFileInfo(path).absoluteFilePath();
+}
+
+QStringList ShaderCache::takeQueue()
+{
+    QMutexLocker lock(&m_mutex);
+
+    QStringList queue;
+    queue.swap(m_queue);
+    return queue;
+}
+
+void ShaderCache::markFailed(const QString &path)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_failed.insert(path);
+    }
+
+    emit shaderCompiled(path);
+}
+
+bool ShaderCache::hasQueued() const
+{
+    QMutexLocker lock(&m_mutex);
+    return !m_queue.isEmpty();
+}
+
+void ShaderCache::markCompiled(const QString &path, const QByteArray &source)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_sources.insert(path, source);
+        m_compiled.insert(path);
+    }
+
+    emit shaderCompiled(path);
+}
+
+void ShaderCache::precompile()
+{
+    if(m_thread) {
+        return;
+    }
+
+    if(!QOpenGLContext::globalShareContext()) {
+        qWarning() << "Shader cache: no global share context, shaders compile on first use";
+        return;
+    }
+
+    // surfaces have to be created on the GUI thread
+    m_surface = new QOffscreenSurface();
+    m_surface->setFormat(QOpenGLContext::globalShareContext()->format());
+    m_surface->create();
+
+    {
+        QMutexLocker lock(&m_mutex);
+        m_queue << m_shaders;
+    }
+
+    m_running = true;
+    m_thread = new CompileThread(this, m_surface);
+    m_thread->start(QThread::LowPriority);
+}
+
+void ShaderCache::request(const QString &path)
+{
+    const QString shader = key(path);
+
+    {
+        QMutexLocker lock(&m_mutex);
+        if(m_compiled.contains(shader) || m_failed.contains(shader) || m_queue.contains(shader)) {
+            return;
+        }
+        m_queue << shader;
+    }
+
+    if(m_thread) {
+        m_thread->wake();
+    }
+}
+
+bool ShaderCache::isRunning() const
+{
+    return m_running;
+}
+
+QStringList ShaderCache::shaders() const
+{
+    return m_shaders;
+}
+
+QStringList ShaderCache::visualisations() const
+{
+    QStringList result;
+    for(const QString& shader : m_shaders) {
+        if(QFileInfo(shader).absolutePath() == m_shaderDir) {
+            result << shader;
+        }
+    }
+    return result;
+}
+
+bool ShaderCache::isCompiled(const QString &path) const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_compiled.contains(key(path));
+}
+
+bool ShaderCache::hasFailed(const QString &path) const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_failed.contains(key(path));
+}
+
+QByteArray ShaderCache::source(const QString &path) const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_sources.value(key(path));
+}
+
+QString ShaderCache::variantKey(const QString &path, const QByteArray &source, int tier)
+{
+    return hasTiers(source) ? key(path) + '#' + QString::number(tier) : key(path);
+}
+
+bool ShaderCache::hasTiers(const QByteArray &source)
+{
+    return source.contains("QUALITY_TIER");
+}
+
+QByteArray ShaderCache::variantSource(const QByteArray &source, int tier)
+{
+    if(!hasTiers(source)) {
+        return source;
+    }
+
+    QByteArray defines = "#define QUALITY_LOW " + QByteArray::number(LowQuality) + "\n"
+            + "#define QUALITY_MEDIUM " + QByteArray::number(MediumQuality) + "\n"
+            + "#define QUALITY_HIGH " + QByteArray::number(HighQuality) + "\n"
+            + "#define QUALITY_TIER " + QByteArray::number(tier) + "\n";
+
+    // #version has to stay the first statement
+    int position = 0;
+    const int version = source.indexOf("#version");
+    if(version != -1) {
+        position = source.indexOf('\n', version) + 1;
+        if(!position) {
+            position = source.size();
+            defines.prepend('\n');
+        }
+    }
+
+    QByteArray result = source;
+    return result.insert(position, defines);
+}
+
+bool ShaderCache::buildProgram(QOpenGLShaderProgram &program, const QByteArray &fragmentSource)
+{
+    // same sources and bindings as the renderer, so both hit the same cache entry
+    program.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vertex_shader_source);
+    program.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, fragmentSource);
+    program.bindAttributeLocation("vertices", 0);
+
+    return program.link();
+}
@@ -0,0 +1,101 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QMutex>
+#include <QThread>
+
+#include <atomic>
+
+class QOffscreenSurface;
+class QOpenGLShaderProgram;
+
+//! Compiles all visualisation shaders in the background at startup.
+//! Programs are linked through Qt's program binary cache, which keeps
+//! binaries on disk keyed by source hash and GL driver, so the render
+//! thread can later link any of them without a compile.
+//! Shaders that test QUALITY_TIER get one program per quality tier.
+//! Requires Qt::AA_ShareOpenGLContexts.
+class ShaderCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Value of QUALITY_TIER injected into shader sources.
+    enum QualityTier {
+        LowQuality,
+        MediumQuality,
+        HighQuality,
+        QualityTierCount
+    };
+
+private:
+    class CompileThread;
+    friend class CompileThread;
+
+    QString m_shaderDir;
+    QStringList m_shaders;
+
+    mutable QMutex m_mutex;
+    QHash<QString, QByteArray> m_sources;
+    QSet<QString> m_compiled;
+    QSet<QString> m_failed;
+    QStringList m_queue;
+
+    std::atomic<bool> m_running;
+
+    QOffscreenSurface* m_surface;
+    CompileThread* m_thread;
+
+    QStringList takeQueue();
+    bool hasQueued() const;
+    void markCompiled(const QString& path, const QByteArray& source);
+    void markFailed(const QString& path);
+
+public:
+    explicit ShaderCache(const QString& shaderDir, QObject* parent = nullptr);
+    ~ShaderCache();
+
+    //! Start compiling every shader of the directory, call from the GUI thread.
+    void precompile();
+
+    //! Compile a shader in the background, e.g. one from outside the directory.
+    void request(const QString& path);
+
+    //! False if there is no shared context to compile in.
+    bool isRunning() const;
+
+    QStringList shaders() const;
+
+    //! Shaders directly in the directory, without render graph passes.
+    QStringList visualisations() const;
+
+    bool isCompiled(const QString& path) const;
+    bool hasFailed(const QString& path) const;
+
+    //! Fragment source of a compiled shader, empty if it is not compiled yet.
+    QByteArray source(const QString& path) const;
+
+    //! Absolute path, shaders are keyed by it.
+    static QString key(const QString& path);
+
+    //! Key of the program a tier uses, tiers share one if the shader ignores them.
+    static QString variantKey(const QString& path, const QByteArray& source, int tier);
+
+    //! True if the shader sizes itself by QUALITY_TIER.
+    static bool hasTiers(const QByteArray& source);
+
+    //! Source with the tier defines injected after #version.
+    static QByteArray variantSource(const QByteArray& source, int tier);
+
+    //! Add the common vertex shader and a fragment shader, bind and link.
+    static bool buildProgram(QOpenGLShaderProgram& program, const QByteArray& fragmentSource);
+
+signals:
+    void shaderCompiled(const QString& path);
+};
+
+#endif // SHADERCACHE_H
@@ -0,0 +1,106 @@
+#include "tagscanner.h"
+#include "coverartcache.h"
+
+#include "ctpl_stl.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QThread>
+
+#include <algorithm>
+
+// small enough for rows to fill in steadily, large enough to keep signals few
+constexpr int batch_size = 32;
+
+// quiet time after the last scan before the index is written
+constexpr int save_delay = 2000;
+
+TagScanner::TagScanner(QObject *parent)
+    : QObject(parent),
+      // leave a core for the GUI and render threads
+      m_pool(new ctpl::thread_pool(std::max(1, QThread::idealThreadCount() - 1))),
+      m_generation(0),
+      m_lastScan(0)
+{
+    qRegisterMetaType<QVector<AudioTagInfo>>();
+
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(save_delay);
+    connect(&m_saveTimer, &QTimer::timeout, this, &TagScanner::saveIndex);
+
+    // tags are kept between sessions
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if(QDir().mkpath(cacheDir)) {
+        m_index.open(cacheDir + "/library.index");
+    }
+}
+
+TagScanner::~TagScanner()
+{
+    // queued batches are skipped, the pool only waits for files being read
+    cancel();
+    m_pool->stop(true);
+
+    m_index.save();
+}
+
+quint64 TagScanner::scan(const QStringList &paths)
+{
+    const quint64 scan = ++m_lastScan;
+    const quint64 generation = m_generation;
+
+    // the last batch to finish schedules a save
+    auto remaining = std::make_shared<std::atomic<int>>((paths.size() + batch_size - 1) / batch_size);
+
+    for(int first = 0; first < paths.size(); first += batch_size) {
+        const QStringList batch = paths.mid(first, batch_size);
+
+        m_pool->push([this, scan, first, batch, generation, remaining](int /* thread_id */) {
+            QVector<AudioTagInfo> tags;
+            tags.reserve(batch.size());
+
+            for(const QString& path : batch) {
+                if(m_generation != generation) {
+                    break;
+                }
+
+                // a stat and a lookup for known files, missing ones are not indexed,
+                // ones whose cover thumbnails were purged are read again
+                const QFileInfo file(path);
+                AudioTagInfo info;
+                if(!file.exists()) {
+                    info = AudioTagInfo::placeholder(path);
+                } else if(!m_index.find(file, info) || !CoverArtCache::hasThumbnails(info.coverUrl)) {
+                    info = AudioTagInfo(path);
+                    m_index.insert(file, info);
+                }
+
+                tags.append(info);
+            }
+
+            if(tags.size() == batch.size()) {
+                emit batchScanned(scan, first, tags);
+            }
+
+            if(--*remaining == 0) {
+                QMetaObject::invokeMethod(&m_saveTimer, "start", Qt::QueuedConnection);
+            }
+        });
+    }
+
+    return scan;
+}
+
+void TagScanner::cancel()
+{
+    ++m_generation;
+}
+
+void TagScanner::saveIndex()
+{
+    // off the GUI thread, scans read the index meanwhile
+    m_pool->push([this](int /* thread_id */) {
+        m_index.save();
+    });
+}
@@ -0,0 +1,57 @@
+#ifndef TAGSCANNER_H
+#define TAGSCANNER_H
+
+#include "audiotaginfo.h"
+#include "libraryindex.h"
+
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+
+namespace ctpl {
+class thread_pool;
+}
+
+//! Reads tags of many files on a thread pool.
+//! Files are read in small batches and every finished batch is reported,
+//! so rows can be filled in while the rest is still being read.
+//! Unchanged files are taken from the library index, which is saved
+//! once no scan has finished for a while, so an import of many small
+//! scans writes it once.
+class TagScanner : public QObject
+{
+    Q_OBJECT
+
+    LibraryIndex m_index;
+    std::unique_ptr<ctpl::thread_pool> m_pool;
+
+    // bumped by cancel(), batches of older scans are dropped
+    std::atomic<quint64> m_generation;
+    quint64 m_lastScan;
+
+    // restarted by every finished scan
+    QTimer m_saveTimer;
+
+    void saveIndex();
+
+public:
+    explicit TagScanner(QObject* parent = nullptr);
+    ~TagScanner();
+
+    //! Read tags of the files in the background.
+    //! Returns the id of the scan, reported with its batches.
+    quint64 scan(const QStringList& paths);
+
+    //! Drop every queued and running scan, e.g. when the playlist is cleared.
+    void cancel();
+
+signals:
+    //! Emitted from a pool thread, 'first' is the index of tags.first() in the scanned paths.
+    void batchScanned(quint64 scan, int first, const QVector<AudioTagInfo>& tags);
+};
+
+#endif // TAGSCANNER_H
@@ -1,80 +1,217 @@
 #include "visualisationrenderer.h"
 #include <QTime>
+#include <QFile>
 #include <QFileInfo>
-#include <QThread>
+#include <QUrl>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 constexpr auto default_shader = "shaders/waveform.glsl";
+// spectrum frames kept in the history texture
+constexpr int history_length = 256;
+// longer gaps between analysis frames are not interpolated over
+constexpr qint64 max_frame_interval_ms = 100;
+constexpr qreal default_target_frame_rate = 60;
+// longer gaps between renders are idle time, not frame time
+constexpr qint64 max_render_interval_ms = 250;
+constexpr qreal default_transition_duration = 2.0;
+
+// fullscreen triangle strip every pass draws
+constexpr GLfloat quad_vertices[] = {
+    -1, -1,
+    1, -1,
+    -1, 1,
+    1, 1
+};
+
+// cross-fades the outgoing shader into the incoming one
+constexpr auto blend_shader_source =
+        "#version 130\n"
+        "uniform sampler2D outgoing;"
+        "uniform sampler2D incoming;"
+        "uniform vec2 resolution;"
+        "uniform float progress;"
+        "void main() {"
+        "    vec2 uv = gl_FragCoord.xy / resolution;"
+        "    gl_FragColor = mix(texture(outgoing, uv), texture(incoming, uv), smoothstep(0.0, 1.0, progress));"
+        "}";
+
+Visualisation::Visualisation()
+    : m_shaderCache(nullptr),
+      m_shader(default_shader),
+      m_autoScale(true),
+      m_targetFrameRate(default_target_frame_rate),
+      m_transitionDuration(default_transition_duration),
+      m_rotateOnTrackChange(false),
+      m_rotateEveryBeats(0),
+      m_renderScale(1.0),
+      m_frameTime(0),
+      m_qualityTier(ShaderCache::HighQuality),
+      m_beats(0)
+{
+    // the framebuffer is at the render scale, following the item would
+    // recreate it on every frame below full scale
+    setTextureFollowsItemSize(false);
+}
+
+QQuickFramebufferObject::Renderer *Visualisation::createRenderer() const
+{
+    return new VisualisationRenderer();
+}
 
-std::vector<GLfloat> Visualisation::readFromBufferToGL(std::shared_ptr<RingBufferT<double>> &buffer)
+void Visualisation::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
 {
-    std::vector<double> result(buffer->getSize());
-    buffer->read(result.data(),
-                 buffer->getAvailableRead());
+    QQuickFramebufferObject::geometryChanged(newGeometry, oldGeometry);
 
-    return std::vector<GLfloat>(result.begin(), result.end());
+    // synchronize() makes a framebuffer of the new size
+    if(newGeometry.size() != oldGeometry.size()) {
+        update();
+    }
 }
 
-Visualisation::Visualisation() : m_renderer(nullptr), m_shader(default_shader)
+void Visualisation::setFrameBuffer(const std::shared_ptr<AnalysisFrameBuffer> &buffer)
 {
-    connect(this, &QQuickItem::windowChanged,
-            this, &Visualisation::handleWindowChanged);
-    connect(&m_updateTimer, &QTimer::timeout,
-            this, &Visualisation::refresh);
-    m_updateTimer.start(50);
+    m_frameBuffer = buffer;
+    update();
 }
 
-void Visualisation::sync()
+void Visualisation::setCurrentShader(const QString &shader)
 {
-    if (!m_renderer) {
-        m_renderer = new VisualisationRenderer();
-        connect(window(), &QQuickWindow::beforeRendering,
-                m_renderer, &VisualisationRenderer::paint, Qt::DirectConnection);
-    }
-    m_renderer->setViewportSize(window()->size() * window()->devicePixelRatio());
-    m_renderer->setWindow(window());
-    m_renderer->setShaderPath(m_shader);
+    if(shader == m_shader) return;
 
-    if(m_waveformBuffer && m_waveformBuffer->getAvailableRead())
-        m_renderer->setWaveformData(readFromBufferToGL(m_waveformBuffer));
-    if(m_spectrumBuffer && m_spectrumBuffer->getAvailableRead())
-        m_renderer->setSpectrumData(readFromBufferToGL(m_spectrumBuffer));
+    m_shader = shader;
+    update();
 }
 
-void Visualisation::cleanup()
+void Visualisation::setShaderCache(ShaderCache *cache)
 {
-    if (m_renderer) {
-        delete m_renderer;
-        m_renderer = nullptr;
+    if(m_shaderCache) {
+        disconnect(m_shaderCache, nullptr, this, nullptr);
     }
+
+    m_shaderCache = cache;
+
+    // a shader we wait for may be ready
+    if(m_shaderCache) {
+        connect(m_shaderCache, &ShaderCache::shaderCompiled,
+                this, &QQuickItem::update, Qt::QueuedConnection);
+    }
+    update();
 }
 
-void Visualisation::setSpectrumBuffer(const std::shared_ptr<RingBufferT<double> > &buffer)
+void Visualisation::setAutoScale(bool autoScale)
 {
-    m_spectrumBuffer = buffer;
+    m_autoScale = autoScale;
+    update();
 }
 
-void Visualisation::setWaveformBuffer(const std::shared_ptr<RingBufferT<double> > &buffer)
+void Visualisation::setTargetFrameRate(qreal fps)
 {
-    m_waveformBuffer = buffer;
+    m_targetFrameRate = fps;
+    update();
 }
 
-void Visualisation::refresh()
+void Visualisation::setTransitionDuration(qreal seconds)
 {
-    //update();
-    window()->update();
+    m_transitionDuration = seconds;
+    update();
+}
+
+void Visualisation::nextShader()
+{
+    QStringList playlist = m_shaderPlaylist;
+    if(playlist.isEmpty() && m_shaderCache) {
+        playlist = m_shaderCache->visualisations();
+    }
+
+    if(playlist.isEmpty()) {
+        return;
+    }
+
+    // playlist and current shader may be paths or file URLs
+    const auto path = [](const QString& shader) {
+        const QUrl url(shader);
+        return ShaderCache::key(url.isLocalFile() ? url.toLocalFile() : shader);
+    };
+
+    const QString current = path(m_shader);
+    int index = 0;
+    for(int i = 0; i < playlist.size(); ++i) {
+        if(path(playlist.at(i)) == current) {
+            index = (i + 1) % playlist.size();
+            break;
+        }
+    }
+
+    m_beats = 0;
+    setCurrentShader(playlist.at(index));
+
+    // have the one after compiled by the time it is needed
+    if(m_shaderCache) {
+        m_shaderCache->request(path(playlist.at((index + 1) % playlist.size())));
+    }
 }
 
-void Visualisation::handleWindowChanged(QQuickWindow *win)
+void Visualisation::trackChanged()
 {
-    if (win) {
-        connect(win, &QQuickWindow::beforeSynchronizing, this, &Visualisation::sync, Qt::DirectConnection);
-        connect(win, &QQuickWindow::sceneGraphInvalidated, this, &Visualisation::cleanup, Qt::DirectConnection);
-        win->setClearBeforeRendering(false);
+    if(m_rotateOnTrackChange) {
+        nextShader();
     }
 }
 
+void Visualisation::frameReady()
+{
+    update();
+}
+
+qreal Visualisation::renderScale() const
+{
+    return m_renderScale;
+}
+
+qreal Visualisation::frameTime() const
+{
+    return m_frameTime;
+}
+
+int Visualisation::qualityTier() const
+{
+    return m_qualityTier;
+}
+
 VisualisationRenderer::VisualisationRenderer()
-    : m_updateShader(false), m_shaderPath(default_shader) {
+    : m_updateShader(false),
+      m_newFrame(true),
+      m_historyHead(0),
+      m_frameSequence(0),
+      m_frameArrival(0),
+      m_frameInterval(0),
+      m_previousFeatures{},
+      m_features{},
+      m_interpolating(false),
+      m_renderTime(0),
+      m_continuous(false),
+      m_dirty(true),
+      m_scaleChanged(false),
+      m_publishedFrameTime(0),
+      m_pixelBuffer(QOpenGLBuffer::PixelUnpackBuffer),
+      m_window(nullptr),
+      m_output(nullptr),
+      m_offlineTime(-1),
+      m_initialized(false),
+      m_shaderCache(nullptr),
+      m_warmIndex(0),
+      m_current{},
+      m_outgoing{},
+      m_transitionStart(-1),
+      m_transitionDuration(default_transition_duration),
+      m_lastBeatPhase(0),
+      m_beats(0),
+      m_shaderPath(default_shader) {
+    m_resolution.setMaxTier(ShaderCache::HighQuality);
+
     // read settings
     //QSettings settings;
 
@@ -92,137 +229,767 @@ VisualisationRenderer::~VisualisationRenderer() {
     //settings.endGroup();
 }
 
-void VisualisationRenderer::setViewportSize(const QSize &size) {
-    m_viewportSize = size;
-}
+QOpenGLFramebufferObject *VisualisationRenderer::createFramebufferObject(const QSize &size) {
+    m_itemSize = size;
+    m_viewportSize = (QSizeF(size) * m_resolution.scale()).toSize().expandedTo(QSize(1, 1));
+    m_dirty = true;
 
-void VisualisationRenderer::setWindow(QQuickWindow *window) {
-    m_window = window;
+    return new QOpenGLFramebufferObject(m_viewportSize);
 }
 
-void VisualisationRenderer::setSpectrumData(const std::vector<GLfloat> &data) {
-    if(!data.empty()) {
-        qDebug() << "Received spectrum data";
-        m_spectrumData = data;
+void VisualisationRenderer::synchronize(QQuickFramebufferObject *item) {
+    auto *visualisation = static_cast<Visualisation*>(item);
+
+    m_window = visualisation->window();
+    if(m_frameBuffer != visualisation->m_frameBuffer) {
+        m_frameBuffer = visualisation->m_frameBuffer;
+        requestAnalysis();
+    }
+    m_shaderCache = visualisation->m_shaderCache;
+    setShaderPath(visualisation->m_shader);
+
+    m_transitionDuration = visualisation->m_transitionDuration;
+
+    // count beats for the item, it rotates shaders on the GUI thread
+    visualisation->m_beats += m_beats;
+    m_beats = 0;
+    if(visualisation->m_rotateEveryBeats > 0 && visualisation->m_beats >= visualisation->m_rotateEveryBeats) {
+        visualisation->m_beats = 0;
+        QMetaObject::invokeMethod(visualisation, "nextShader", Qt::QueuedConnection);
+    }
+
+    m_resolution.setEnabled(visualisation->m_autoScale);
+    if(!qFuzzyCompare(m_resolution.targetFrameRate(), visualisation->m_targetFrameRate)) {
+        m_resolution.setTargetFrameRate(visualisation->m_targetFrameRate);
+    }
+
+    // same size as QQuickFramebufferObject passes to createFramebufferObject()
+    const qreal pixelRatio = m_window ? m_window->effectiveDevicePixelRatio() : 1.;
+    const QSize itemSize = QSize(int(visualisation->width()), int(visualisation->height()))
+            .expandedTo(QSize(1, 1)) * pixelRatio;
+
+    if(m_scaleChanged || itemSize != m_itemSize
+            || !qFuzzyCompare(visualisation->m_renderScale, m_resolution.scale())) {
+        invalidateFramebufferObject();
+        m_scaleChanged = false;
+    }
+
+    // GUI thread is blocked here, but signals have to be emitted on it
+    if(!qFuzzyCompare(visualisation->m_renderScale, m_resolution.scale())
+            || visualisation->m_qualityTier != m_resolution.tier()
+            || qAbs(m_publishedFrameTime - m_resolution.frameTime()) > 0.5) {
+        visualisation->m_renderScale = m_resolution.scale();
+        visualisation->m_qualityTier = m_resolution.tier();
+        visualisation->m_frameTime = m_resolution.frameTime();
+        m_publishedFrameTime = m_resolution.frameTime();
+
+        QMetaObject::invokeMethod(visualisation, "renderStatsChanged", Qt::QueuedConnection);
     }
 }
 
-void VisualisationRenderer::setWaveformData(const std::vector<GLfloat> &data) {
-    if(!data.empty()) {
-        qDebug() << "Received waveform data";
-        m_waveformData = data;
+void VisualisationRenderer::interpolateFeatures() {
+    const audioengine::FrameFeatures& target = frame().features;
+
+    if(!m_interpolating) {
+        m_features = target;
+        return;
+    }
+
+    const double t = m_frameInterval > 0
+            ? std::min(1., (elapsed() - m_frameArrival) / m_frameInterval)
+            : 1.;
+
+    // all features are floats
+    static_assert(sizeof(audioengine::FrameFeatures) % sizeof(float) == 0,
+                  "FrameFeatures must only hold floats");
+    constexpr size_t count = sizeof(audioengine::FrameFeatures) / sizeof(float);
+
+    const float* from = reinterpret_cast<const float*>(&m_previousFeatures);
+    const float* to = reinterpret_cast<const float*>(&target);
+    float* out = reinterpret_cast<float*>(&m_features);
+
+    for(size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<float>(from[i] + (to[i] - from[i]) * t);
+    }
+
+    // beat phase only moves forward and wraps around
+    float phase_step = target.beat_phase - m_previousFeatures.beat_phase;
+    if(phase_step < 0) {
+        phase_step += 1.f;
     }
+    m_features.beat_phase = std::fmod(m_previousFeatures.beat_phase + static_cast<float>(phase_step * t), 1.f);
+
+    if(t >= 1.) {
+        m_interpolating = false;
+    }
+}
+
+const audioengine::AnalysisFrame &VisualisationRenderer::frame() const {
+    // silence until the analyzer publishes
+    static const audioengine::AnalysisFrame empty_frame {};
+
+    return m_frameBuffer && m_frameSequence ? m_frameBuffer->read_buffer() : empty_frame;
 }
 
 /* NOTE: this expects OpenGL shader to have:
     uniform sampler2D fftwave; // frequency data and waveform in one texture
+        row 0 - spectrum: r mono, g left, b right, a side
+        row 1 - waveform: r mono, g b a left, right and side goniometer points
     uniform highp vec2 resolution; // viewport resolution
+   and optionally:
+    uniform int sample_size; // frequency data width
+    uniform float time; // seconds since start
+    uniform float bpm; // tempo of the track, 0 if unknown
+    uniform float beat_phase; // 0 - 1, 0 is on the beat
+    uniform float onset; // onset strength, about 1 on a typical onset
+   per channel features as vec2(left, right):
+    uniform vec2 rms;
+    uniform vec2 peak;
+    uniform vec2 centroid; // 0 - 1 of the spectrum width
+    uniform vec2 flux;
+    uniform vec2 bands_low; // below 250 Hz
+    uniform vec2 bands_mid; // 250 - 4000 Hz
+    uniform vec2 bands_high; // above 4000 Hz
+   and coarse mono spectrum:
+    uniform float bands[64];
+   spectrum history, a ring of the last history_size spectrum rows:
+    uniform sampler2D history; // same channels as fftwave row 0
+    uniform int history_head; // row of the newest frame
+    uniform int history_size; // rows in the ring
+   the g b a channels of fftwave row 0 and history are only filled while
+    a shader of the graph mentions STEREO_SPECTRUM, e.g. in a comment, or
+    uses one of centroid, flux, bands_low, bands_mid or bands_high
+   shaders that mention QUALITY_TIER are compiled once per tier, with
+    #define QUALITY_TIER, one of QUALITY_LOW, QUALITY_MEDIUM or QUALITY_HIGH
+   injected after #version
+   with a render graph sidecar, see RenderGraph, the inputs of a pass:
+    uniform sampler2D <pass name>; // output of that pass
+   and resolution is the size of the pass buffer
  */
-void VisualisationRenderer::paint()
+void VisualisationRenderer::render()
 {
-    //std::unique_lock<std::mutex> lock(m_mtx);
+    renderFrame(framebufferObject());
+}
 
-    if (!m_program) {
+void VisualisationRenderer::renderOffline(QOpenGLFramebufferObject *output, qint64 timeMs)
+{
+    // fixed size and clock, every frame shows its own analysis frame
+    m_offlineTime = timeMs;
+    m_viewportSize = output->size();
+    m_resolution.setEnabled(false);
+
+    output->bind();
+    renderFrame(output);
+    output->release();
+}
+
+qint64 VisualisationRenderer::elapsed() const
+{
+    return m_offlineTime >= 0 ? m_offlineTime : m_frameClock.elapsed();
+}
+
+void VisualisationRenderer::renderFrame(QOpenGLFramebufferObject *output)
+{
+    if (!m_initialized) {
         initializeOpenGLFunctions();
-        m_ticker.start();
+        m_frameClock.start();
+
+        m_initialized = true;
+    }
 
-        m_program = std::make_unique<QOpenGLShaderProgram>();
+    m_output = output;
 
-        m_updateShader = true;
+    // nothing to draw yet also needs a program
+    bool warming = false;
+    if(m_updateShader || m_current.programs.isEmpty()) {
+        selectProgram();
+    } else {
+        warming = warmPrograms();
     }
 
-    if(m_updateShader) {
-        m_program->removeAllShaders();
-        swapShaders();
+    if(m_current.programs.isEmpty()) {
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+        return;
+    }
 
-        m_program->addCacheableShaderFromSourceCode(QOpenGLShader::Vertex,
-                                                    "attribute highp vec4 vertices;"
-                                                    "void main() {"
-                                                    "    gl_Position = vertices;"
-                                                    "}");
-        m_program->addShader(m_shader.get());
-        m_program->bindAttributeLocation("vertices", 0);
-        m_program->link();
+    // frame time only means something while rendering every vsync
+    const qint64 now = elapsed();
+    bool tierChanged = false;
+    if(m_continuous && now - m_renderTime < max_render_interval_ms) {
+        const qreal scale = m_resolution.scale();
+        const int tier = m_resolution.tier();
 
-        m_updateShader = false;
+        if(m_resolution.addFrame(now - m_renderTime)) {
+            m_scaleChanged = m_scaleChanged || !qFuzzyCompare(scale, m_resolution.scale());
+
+            // the next frame swaps in the variant of the new tier
+            tierChanged = tier != m_resolution.tier();
+            m_updateShader = m_updateShader || tierChanged;
+        }
+    } else {
+        m_resolution.reset();
     }
+    m_renderTime = now;
 
-    m_program->bind();
-    m_program->enableAttributeArray(0);
+    // take the newest complete frame, no copies
+    // the analyzer can publish the frame on screen again, e.g. when woken while paused
+    if(m_frameBuffer && m_frameBuffer->update() && !isFrameShown()) {
+        m_frameSequence = m_frameBuffer->read_sequence();
+        m_newFrame = true;
+
+        const qint64 interval = std::min(now - m_frameArrival, max_frame_interval_ms);
+
+        m_frameInterval = m_frameInterval > 0 ? 0.9 * m_frameInterval + 0.1 * interval : interval;
+        m_frameArrival = now;
+
+        // continue from what is on screen
+        m_previousFeatures = m_features;
+        m_interpolating = m_offlineTime < 0;
+    }
+
+    // nothing moves without new input, the output still holds the last frame
+    const bool animated = m_current.usesTime || m_current.graph.hasFeedback() || m_transitionStart >= 0;
+    if(!m_dirty && !m_newFrame && !m_interpolating && !animated) {
+        if(m_window) {
+            m_window->resetOpenGLState();
+        }
+
+        m_continuous = false;
+        if(warming || tierChanged || m_scaleChanged) {
+            update();
+        }
+        return;
+    }
+    m_dirty = false;
+
+    interpolateFeatures();
+
+    // shaders rotating on beats count phase wraps
+    if(m_features.bpm > 0 && m_features.beat_phase < m_lastBeatPhase - 0.5f) {
+        ++m_beats;
+    }
+    m_lastBeatPhase = m_features.beat_phase;
 
     if(!m_texture) {
-        m_texture = std::make_shared<QOpenGLTexture>(QOpenGLTexture::Target2D);
-        m_texture->create();
-        m_texture->setFormat(QOpenGLTexture::R32F);
-        m_texture->setSize(m_spectrumData.size(), 2);
-        m_texture->allocateStorage(QOpenGLTexture::Red, QOpenGLTexture::Float32);
+        allocateTextures();
     }
     updateTexture();
 
-    glViewport(0, 0, m_viewportSize.width(), m_viewportSize.height());
+    glDisable(GL_DEPTH_TEST);
 
-    GLfloat values[] = {
-        -1, -1,
-        1, -1,
-        -1, 1,
-        1, 1
-    };
+    m_texture->bind(0);
+    m_historyTexture->bind(1);
+
+    const qreal progress = m_transitionStart >= 0 && m_transitionDuration > 0
+            ? (now - m_transitionStart) / (1000. * m_transitionDuration)
+            : 1.;
+
+    if(progress < 1.) {
+        renderTransition(progress);
+    } else {
+        // done fading, free the outgoing buffers
+        if(m_transitionStart >= 0) {
+            m_outgoing = GraphState();
+            m_transitionBuffers[0].reset();
+            m_transitionBuffers[1].reset();
+            m_transitionStart = -1;
+            requestAnalysis();
+        }
 
-    m_program->setAttributeArray(0, GL_FLOAT, values, 2);
+        renderGraph(m_current, m_output);
+    }
 
-    m_program->setUniformValue("fftwave", 0);
-    m_program->setUniformValue("resolution", m_viewportSize);
-    m_program->setUniformValue("sample_size", (GLint) m_waveformData.size());
-    m_program->setUniformValue("time", (GLfloat) m_ticker.elapsed() / 1000.f);
+    m_historyTexture->release(1);
+    m_texture->release(0);
 
-    glDisable(GL_DEPTH_TEST);
+    if(m_window) {
+        m_window->resetOpenGLState();
+    }
+
+    // otherwise wait for the next analysis frame or compiled shader,
+    // feedback passes change with every frame they render
+    m_continuous = m_current.usesTime || m_current.graph.hasFeedback()
+            || m_transitionStart >= 0 || m_interpolating || m_scaleChanged;
+    if(m_continuous || warming || tierChanged || m_updateShader) {
+        update();
+    }
+}
+
+bool VisualisationRenderer::isFrameShown() const
+{
+    const audioengine::AnalysisFrame& current = m_frameBuffer->read_buffer();
+
+    if(m_interpolating || std::memcmp(&current.features, &m_features, sizeof(audioengine::FrameFeatures)) != 0) {
+        return false;
+    }
+
+    const size_t texels = static_cast<size_t>(audioengine::analysis_texture_width)
+            * audioengine::analysis_texture_channels * audioengine::analysis_texture_rows;
+
+    return m_uploadedTexture.size() == texels
+            && std::memcmp(m_uploadedTexture.data(), current.texture, texels * sizeof(uint16_t)) == 0;
+}
+
+void VisualisationRenderer::setUniforms(QOpenGLShaderProgram *program, const QSize &size)
+{
+    const audioengine::FrameFeatures& features = m_features;
+
+    program->setUniformValue("fftwave", 0);
+    program->setUniformValue("history", 1);
+    program->setUniformValue("history_head", (GLint) m_historyHead);
+    program->setUniformValue("history_size", (GLint) history_length);
+    program->setUniformValue("resolution", size);
+    program->setUniformValue("sample_size", (GLint) audioengine::analysis_texture_width);
+    program->setUniformValue("time", (GLfloat) elapsed() / 1000.f);
+    program->setUniformValue("bpm", (GLfloat) features.bpm);
+    program->setUniformValue("beat_phase", (GLfloat) features.beat_phase);
+    program->setUniformValue("onset", (GLfloat) features.onset_strength);
+    program->setUniformValue("rms", features.rms[0], features.rms[1]);
+    program->setUniformValue("peak", features.peak[0], features.peak[1]);
+    program->setUniformValue("centroid", features.centroid[0], features.centroid[1]);
+    program->setUniformValue("flux", features.flux[0], features.flux[1]);
+    program->setUniformValue("bands_low", features.low[0], features.low[1]);
+    program->setUniformValue("bands_mid", features.mid[0], features.mid[1]);
+    program->setUniformValue("bands_high", features.high[0], features.high[1]);
+    program->setUniformValueArray("bands", features.bands, audioengine::feature_band_count, 1);
+}
+
+void VisualisationRenderer::drawPass(const GraphState &state, int index, const QSize &size)
+{
+    QOpenGLShaderProgram* program = state.programs.at(index);
+    const RenderGraph::Pass& pass = state.graph.passes().at(index);
+
+    program->bind();
+    program->enableAttributeArray(0);
+    program->setAttributeArray(0, GL_FLOAT, quad_vertices, 2);
+
+    setUniforms(program, size);
+
+    // pass outputs go after fftwave and history
+    for(int i = 0; i < pass.inputs.size(); ++i) {
+        const PassTarget& input = state.targets.at(state.graph.passIndex(pass.inputs.at(i)));
+        const int unit = 2 + i;
+
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, input.buffers[input.latest]->texture());
+        program->setUniformValue(pass.inputs.at(i).toLatin1().constData(), (GLint) unit);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glViewport(0, 0, size.width(), size.height());
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    program->disableAttributeArray(0);
+    program->release();
+}
+
+void VisualisationRenderer::renderGraph(GraphState &state, QOpenGLFramebufferObject *output)
+{
+    const QVector<RenderGraph::Pass>& passes = state.graph.passes();
+
+    if(state.targets.size() != passes.size() - 1 || state.viewport != m_viewportSize) {
+        allocatePassTargets(state);
+    }
+
+    // offscreen passes in order, then the shader itself into the output
+    const int screenPass = passes.size() - 1;
+    for(int i = 0; i < screenPass; ++i) {
+        PassTarget& target = state.targets[i];
+
+        // a feedback pass keeps its last frame for readers, write the other buffer
+        const int written = passes.at(i).feedback ? 1 - target.latest : target.latest;
+
+        target.buffers[written]->bind();
+        drawPass(state, i, target.buffers[written]->size());
+        target.latest = written;
+    }
+
+    output->bind();
 
     glClearColor(0, 0, 0, 1);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    m_texture->bind();
+    drawPass(state, screenPass, m_viewportSize);
+}
+
+void VisualisationRenderer::renderTransition(qreal progress)
+{
+    if(!m_blendProgram) {
+        m_blendProgram = std::make_shared<QOpenGLShaderProgram>();
+        if(!ShaderCache::buildProgram(*m_blendProgram, blend_shader_source)) {
+            qWarning() << "Transition shader failed:" << m_blendProgram->log();
+        }
+    }
+
+    for(auto& buffer : m_transitionBuffers) {
+        if(!buffer || buffer->size() != m_viewportSize) {
+            buffer = std::make_shared<QOpenGLFramebufferObject>(m_viewportSize);
+        }
+    }
+
+    // both shaders keep running while they blend
+    renderGraph(m_outgoing, m_transitionBuffers[0].get());
+    renderGraph(m_current, m_transitionBuffers[1].get());
+
+    m_output->bind();
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, m_transitionBuffers[0]->texture());
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, m_transitionBuffers[1]->texture());
+    glActiveTexture(GL_TEXTURE0);
+
+    m_blendProgram->bind();
+    m_blendProgram->enableAttributeArray(0);
+    m_blendProgram->setAttributeArray(0, GL_FLOAT, quad_vertices, 2);
+    m_blendProgram->setUniformValue("outgoing", 2);
+    m_blendProgram->setUniformValue("incoming", 3);
+    m_blendProgram->setUniformValue("resolution", m_viewportSize);
+    m_blendProgram->setUniformValue("progress", (GLfloat) progress);
+
+    glViewport(0, 0, m_viewportSize.width(), m_viewportSize.height());
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-    m_program->disableAttributeArray(0);
+    m_blendProgram->disableAttributeArray(0);
+    m_blendProgram->release();
+}
 
-    m_texture->release();
-    m_program->release();
-    //m_window->resetOpenGLState();
+void VisualisationRenderer::allocatePassTargets(GraphState &state)
+{
+    // on a resize, e.g. a scale step, feedback passes keep what they accumulated
+    const QVector<PassTarget> previous = state.targets.size() == state.graph.passes().size() - 1
+            ? state.targets : QVector<PassTarget>();
+
+    state.viewport = m_viewportSize;
+    state.targets.clear();
+
+    QOpenGLFramebufferObjectFormat format;
+    format.setInternalTextureFormat(QOpenGLTexture::RGBA16F);
+
+    const QVector<RenderGraph::Pass>& passes = state.graph.passes();
+    for(int i = 0; i < passes.size() - 1; ++i) {
+        const QSize size = (QSizeF(m_viewportSize) * passes.at(i).scale).toSize().expandedTo(QSize(1, 1));
+
+        PassTarget target;
+        target.latest = 0;
+
+        for(int buffer = 0; buffer < (passes.at(i).feedback ? 2 : 1); ++buffer) {
+            target.buffers[buffer] = std::make_shared<QOpenGLFramebufferObject>(size, format);
+
+            // scaled passes are sampled at screen size
+            glBindTexture(GL_TEXTURE_2D, target.buffers[buffer]->texture());
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+            // feedback starts from black, or from its last frame scaled to the new size
+            target.buffers[buffer]->bind();
+            glClearColor(0, 0, 0, 0);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            if(passes.at(i).feedback && i < previous.size()
+                    && QOpenGLFramebufferObject::hasOpenGLFramebufferBlit()) {
+                const PassTarget& last = previous.at(i);
+                QOpenGLFramebufferObject::blitFramebuffer(target.buffers[buffer].get(),
+                                                          last.buffers[last.latest].get(),
+                                                          GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            }
+        }
+
+        state.targets << target;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_output->bind();
+}
+
+// the analysis size is fixed at compile time, textures are allocated once
+void VisualisationRenderer::allocateTextures() {
+    m_texture = std::make_shared<QOpenGLTexture>(QOpenGLTexture::Target2D);
+    m_texture->create();
+    m_texture->setFormat(QOpenGLTexture::RGBA16F);
+    m_texture->setSize(audioengine::analysis_texture_width, audioengine::analysis_texture_rows);
+    m_texture->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::Float16);
+
+    m_historyTexture = std::make_shared<QOpenGLTexture>(QOpenGLTexture::Target2D);
+    m_historyTexture->create();
+    m_historyTexture->setFormat(QOpenGLTexture::RGBA16F);
+    m_historyTexture->setSize(audioengine::analysis_texture_width, history_length);
+    m_historyTexture->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::Float16);
+    m_historyTexture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+    m_historyTexture->setWrapMode(QOpenGLTexture::DirectionS, QOpenGLTexture::ClampToEdge);
+    m_historyTexture->setWrapMode(QOpenGLTexture::DirectionT, QOpenGLTexture::Repeat);
+
+    // start from silence
+    std::vector<uint16_t> silence(static_cast<size_t>(audioengine::analysis_texture_width)
+                                  * audioengine::analysis_texture_channels * history_length, 0);
+    m_historyTexture->setData(QOpenGLTexture::RGBA, QOpenGLTexture::Float16, silence.data());
+    m_historyHead = 0;
+
+    // staging buffer for one frame, orphaned on every upload
+    if(!m_pixelBuffer.isCreated()) {
+        m_pixelBuffer.create();
+        m_pixelBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    }
+
+    // NaN never comes from the analyzer, so every row is uploaded first time
+    m_uploadedTexture.assign(static_cast<size_t>(audioengine::analysis_texture_width)
+                             * audioengine::analysis_texture_channels
+                             * audioengine::analysis_texture_rows, 0xffff);
 
-    QThread::usleep(100);
+    m_newFrame = true;
 }
 
 void VisualisationRenderer::updateTexture() {
-    std::vector<GLfloat> texture_data;
-    texture_data.reserve(m_spectrumData.size() * 2);
+    if(!m_newFrame) {
+        return;
+    }
+
+    const uint16_t* texture_data = frame().texture;
+    const size_t row_texels = static_cast<size_t>(audioengine::analysis_texture_width) * audioengine::analysis_texture_channels;
+    const int row_bytes = static_cast<int>(row_texels * sizeof(uint16_t));
+    const int frame_bytes = row_bytes * audioengine::analysis_texture_rows;
+
+    // stage the frame, orphaning the old storage so the driver never waits for the GPU
+    m_pixelBuffer.bind();
+    m_pixelBuffer.allocate(frame_bytes);
+
+    void* staging = m_pixelBuffer.mapRange(0, frame_bytes,
+                                           QOpenGLBuffer::RangeWrite | QOpenGLBuffer::RangeInvalidateBuffer);
+    if(staging) {
+        std::memcpy(staging, texture_data, frame_bytes);
+        m_pixelBuffer.unmap();
+    } else {
+        m_pixelBuffer.write(0, texture_data, frame_bytes);
+    }
+
+    // upload only the rows that changed, waveform rows often do not while paused
+    m_texture->bind();
+    for(int row = 0; row < audioengine::analysis_texture_rows; ++row) {
+        const size_t offset = row * row_texels;
+
+        if(std::memcmp(&m_uploadedTexture[offset], texture_data + offset, row_bytes) == 0) {
+            continue;
+        }
+
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, audioengine::analysis_texture_width, 1,
+                        QOpenGLTexture::RGBA, QOpenGLTexture::Float16,
+                        reinterpret_cast<const void*>(static_cast<quintptr>(row * row_bytes)));
+        std::memcpy(&m_uploadedTexture[offset], texture_data + offset, row_bytes);
+    }
+    m_texture->release();
+
+    // one row per frame, spectrum row goes to the head of the ring
+    m_historyHead = (m_historyHead + 1) % history_length;
+
+    m_historyTexture->bind();
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, m_historyHead, audioengine::analysis_texture_width, 1,
+                    QOpenGLTexture::RGBA, QOpenGLTexture::Float16, nullptr);
+    m_historyTexture->release();
+
+    m_pixelBuffer.release();
+
+    m_newFrame = false;
+}
+
+bool VisualisationRenderer::linkProgram(const QString &path, const QByteArray &source, int tier)
+{
+    m_sources.insert(path, source);
+
+    const QString key = ShaderCache::variantKey(path, source, tier);
+    if(m_programs.contains(key)) {
+        return true;
+    }
+
+    auto program = std::make_shared<QOpenGLShaderProgram>();
+
+    if(!ShaderCache::buildProgram(*program, ShaderCache::variantSource(source, tier))) {
+        qWarning() << "Shader failed:" << key << program->log();
+        return false;
+    }
+
+    m_programs.insert(key, program);
+    return true;
+}
+
+QOpenGLShaderProgram *VisualisationRenderer::residentProgram(const QString &path, int tier) const
+{
+    auto source = m_sources.constFind(path);
+    if(source == m_sources.constEnd()) {
+        return nullptr;
+    }
+
+    return m_programs.value(ShaderCache::variantKey(path, *source, tier)).get();
+}
+
+void VisualisationRenderer::useGraph(const QString &path, const RenderGraph &graph, const QVector<QOpenGLShaderProgram *> &programs)
+{
+    // a new shader fades in over the one on screen, a new tier just swaps programs
+    if(path != m_current.path) {
+        if(!m_current.programs.isEmpty() && m_transitionDuration > 0) {
+            m_outgoing = m_current;
+            m_transitionStart = elapsed();
+        }
+
+        m_current = GraphState();
+        m_current.path = path;
+        m_current.graph = graph;
+    }
+
+    m_current.programs = programs;
+    m_dirty = true;
+
+    // shaders animated by time need every vsync
+    m_current.usesTime = false;
+    for(QOpenGLShaderProgram* program : programs) {
+        m_current.usesTime = m_current.usesTime || program->uniformLocation("time") != -1;
+    }
 
-    texture_data.insert(texture_data.begin(), m_spectrumData.begin(), m_spectrumData.end());
-    texture_data.insert(texture_data.end(), m_waveformData.begin(), m_waveformData.end());
+    // texture channels can not be queried like uniforms, such shaders say so
+    static const char* const stereoUniforms[] = { "centroid", "flux", "bands_low", "bands_mid", "bands_high" };
+    m_current.usesStereo = false;
+    for(const RenderGraph::Pass& pass : m_current.graph.passes()) {
+        m_current.usesStereo = m_current.usesStereo || m_sources.value(pass.shader).contains("STEREO_SPECTRUM");
+    }
+    for(QOpenGLShaderProgram* program : programs) {
+        for(const char* uniform : stereoUniforms) {
+            m_current.usesStereo = m_current.usesStereo || program->uniformLocation(uniform) != -1;
+        }
+    }
 
-    m_texture->setData(QOpenGLTexture::Red, QOpenGLTexture::Float32, texture_data.data());
+    requestAnalysis();
 }
 
-void VisualisationRenderer::swapShaders()
+void VisualisationRenderer::requestAnalysis()
 {
-    //std::unique_lock<std::mutex> lock(m_mtx);
-    std::unique_ptr<QOpenGLShader> shader;
-    shader = std::make_unique<QOpenGLShader>(QOpenGLShader::Fragment);
+    // until a shader is loaded the analyzer keeps computing everything,
+    // a fading out shader still reads its channels
+    if(m_frameBuffer && !m_current.programs.isEmpty()) {
+        m_frameBuffer->stereo_wanted = m_current.usesStereo
+                || (m_transitionStart >= 0 && m_outgoing.usesStereo);
+    }
+}
 
-    if(shader->compileSourceFile(m_shaderPath)) {
-        if(!m_shader) {
-            m_shader = std::make_unique<QOpenGLShader>(QOpenGLShader::Fragment);
+QOpenGLShaderProgram *VisualisationRenderer::acquireProgram(const QString &path, int tier, bool &pending)
+{
+    // resident, just swap
+    if(QOpenGLShaderProgram* program = residentProgram(path, tier)) {
+        return program;
+    }
+
+    // keep drawing the current shader until this one is compiled in the background
+    if(!m_current.programs.isEmpty() && m_shaderCache && m_shaderCache->isRunning()) {
+        if(m_shaderCache->isCompiled(path)) {
+            return linkProgram(path, m_shaderCache->source(path), tier) ? residentProgram(path, tier) : nullptr;
+        }
+
+        if(!m_shaderCache->hasFailed(path)) {
+            m_shaderCache->request(path);
+            pending = true;
         }
+        return nullptr;
+    }
 
-        m_shader.swap(shader);
+    // nothing to draw yet or no background compiler
+    QFile file(path);
+    if(file.open(QIODevice::ReadOnly) && linkProgram(path, file.readAll(), tier)) {
+        return residentProgram(path, tier);
     }
+    return nullptr;
 }
 
-void VisualisationRenderer::setShaderPath(const QUrl &path) {
-    if(path == m_shaderPath) return;
+void VisualisationRenderer::selectProgram()
+{
+    const QString path = ShaderCache::key(m_shaderPath);
+    const int tier = m_resolution.tier();
 
+    // sidecars are read once
+    auto graph = m_graphs.constFind(path);
+    if(graph == m_graphs.constEnd()) {
+        graph = m_graphs.insert(path, RenderGraph::load(path));
+    }
+
+    QVector<QOpenGLShaderProgram*> programs;
+    bool pending = false;
+    bool failed = false;
+
+    for(const RenderGraph::Pass& pass : graph->passes()) {
+        bool compiling = false;
+        QOpenGLShaderProgram* program = acquireProgram(pass.shader, tier, compiling);
+
+        pending = pending || compiling;
+        failed = failed || (!program && !compiling);
+        programs << program;
+    }
+
+    // keep the current one, like a failed compile always did
+    if(failed) {
+        m_updateShader = false;
+        return;
+    }
+
+    // wait for the rest to compile in the background
+    if(pending) {
+        return;
+    }
+
+    // a running fade finishes first, restarting it would cut the half blended image
+    if(path != m_current.path && m_transitionStart >= 0) {
+        return;
+    }
+
+    useGraph(path, *graph, programs);
+    m_updateShader = false;
+}
+
+bool VisualisationRenderer::warmPrograms()
+{
+    if(!m_shaderCache) {
+        return false;
+    }
+
+    // link at most one compiled variant per frame from the binary cache
+    const QStringList shaders = m_shaderCache->shaders();
+    const int variants = shaders.size() * ShaderCache::QualityTierCount;
+    while(m_warmIndex < variants) {
+        const QString& path = shaders.at(m_warmIndex / ShaderCache::QualityTierCount);
+        const int tier = m_warmIndex % ShaderCache::QualityTierCount;
+
+        // tiers of a shader that ignores them share one program
+        if(residentProgram(path, tier) || m_shaderCache->hasFailed(path)) {
+            ++m_warmIndex;
+            continue;
+        }
+
+        // the rest are linked on the next frames
+        if(m_shaderCache->isCompiled(path)) {
+            linkProgram(path, m_shaderCache->source(path), tier);
+            ++m_warmIndex;
+            return true;
+        }
+        break;
+    }
+
+    return false;
+}
+
+void VisualisationRenderer::setFrameBuffer(const std::shared_ptr<AnalysisFrameBuffer> &buffer)
+{
+    m_frameBuffer = buffer;
+    requestAnalysis();
+}
+
+void VisualisationRenderer::setShaderPath(const QUrl &path) {
     // cut file://
-    m_shaderPath = QFileInfo(path.toLocalFile()).absoluteFilePath();
+    const QString shaderPath = path.isLocalFile()
+            ? QFileInfo(path.toLocalFile()).absoluteFilePath()
+            : path.toString();
+
+    if(shaderPath == m_shaderPath) return;
 
+    m_shaderPath = shaderPath;
     m_updateShader = true;
 }
 
@@ -1,91 +1,237 @@
 #ifndef VISUALISATION_RENDERER_H
 #define VISUALISATION_RENDERER_H
 
-#include <QQuickItem>
+#include <QQuickFramebufferObject>
+#include <QOpenGLFramebufferObject>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLFunctions>
 #include <QOpenGLTexture>
+#include <QOpenGLBuffer>
 #include <QQuickWindow>
+#include <QElapsedTimer>
 #include <QTime>
-#include <QTimer>
 #include <QSettings>
+#include <QHash>
+#include <QVector>
+#include <QStringList>
 
 #include <memory>
-#include <mutex>
 
-#include "audio_engine/ringbuffer.h"
-
-class VisualisationRenderer : public QObject, protected QOpenGLFunctions
+#include "audio_engine/framefeatures.h"
+#include "audio_engine/triplebuffer.h"
+#include "audio_engine/types.h"
+#include "rendergraph.h"
+#include "resolutioncontroller.h"
+#include "shadercache.h"
+
+using AnalysisFrameBuffer = audioengine::AnalysisFrameBuffer;
+
+/*
+ * VisualisationRenderer draws the current shader into the item framebuffer
+ * on the scene graph render thread, in step with the display refresh.
+ * It only asks for the next frame while something changes on screen:
+ * a new analysis frame, features still interpolating, or a shader using time.
+ * While rendering continuously it renders at a reduced scale when frames
+ * are late, and the item upscales the result to its size. Past half scale
+ * it switches to a lower quality tier variant of the shader instead.
+ * A shader with a render graph sidecar first renders its offscreen passes.
+ * Switching shaders renders both graphs into their own framebuffers
+ * and cross-fades between them.
+ */
+class VisualisationRenderer : public QQuickFramebufferObject::Renderer, protected QOpenGLFunctions
 {
-    Q_OBJECT
-
 public:
     VisualisationRenderer();
     ~VisualisationRenderer();
 
-    void setViewportSize(const QSize &size);
+    QOpenGLFramebufferObject *createFramebufferObject(const QSize &size) override;
+    void synchronize(QQuickFramebufferObject *item) override;
+    void render() override;
 
-    void setWindow(QQuickWindow *window);
-    void setSpectrumData(const std::vector<GLfloat>& data);
-    void setWaveformData(const std::vector<GLfloat>& data);
+    //! Headless use without an item, render into output as of timeMs
+    //! with the current context. Frames are not interpolated.
+    void renderOffline(QOpenGLFramebufferObject* output, qint64 timeMs);
 
+    void setFrameBuffer(const std::shared_ptr<AnalysisFrameBuffer>& buffer);
     void setShaderPath(const QUrl& path);
 
     QString shaderPath() const;
 
-public slots:
-    void paint();
-
 private:
+    // output of an offscreen pass, feedback passes ping-pong between two buffers
+    struct PassTarget {
+        std::shared_ptr<QOpenGLFramebufferObject> buffers[2];
+        int latest;
+    };
+
+    // a shader with its render graph, programs and pass buffers
+    struct GraphState {
+        QString path;
+        RenderGraph graph;
+        QVector<QOpenGLShaderProgram*> programs;
+        QVector<PassTarget> targets;
+        QSize viewport;
+        bool usesTime;
+        // reads stereo spectra or per channel spectral features
+        bool usesStereo;
+    };
+
+    void renderFrame(QOpenGLFramebufferObject* output);
+    qint64 elapsed() const;
+    void interpolateFeatures();
+    void allocateTextures();
+    void requestAnalysis();
     void updateTexture();
-    void swapShaders();
+    bool linkProgram(const QString& path, const QByteArray& source, int tier);
+    QOpenGLShaderProgram* residentProgram(const QString& path, int tier) const;
+    QOpenGLShaderProgram* acquireProgram(const QString& path, int tier, bool& pending);
+    void useGraph(const QString& path, const RenderGraph& graph, const QVector<QOpenGLShaderProgram*>& programs);
+    void selectProgram();
+    void allocatePassTargets(GraphState& state);
+    void setUniforms(QOpenGLShaderProgram* program, const QSize& size);
+    void drawPass(const GraphState& state, int index, const QSize& size);
+    void renderGraph(GraphState& state, QOpenGLFramebufferObject* output);
+    void renderTransition(qreal progress);
+    bool warmPrograms();
+    const audioengine::AnalysisFrame& frame() const;
+    bool isFrameShown() const;
+
     bool m_updateShader;
+    bool m_newFrame;
+    int m_historyHead;
+    uint64_t m_frameSequence;
 
     QSize m_viewportSize;
-    QTime m_ticker;
-    std::mutex m_mtx;
-
-    std::vector<GLfloat> m_spectrumData;
-    std::vector<GLfloat> m_waveformData;
+    // item size in pixels the framebuffer was made for, it does not follow the item by itself
+    QSize m_itemSize;
+
+    // drives time and interpolation, offline rendering sets a fixed time instead
+    QElapsedTimer m_frameClock;
+
+    // features shown on screen move from the previous frame to the current one
+    // over one analysis frame interval
+    qint64 m_frameArrival;
+    double m_frameInterval;
+    audioengine::FrameFeatures m_previousFeatures;
+    audioengine::FrameFeatures m_features;
+    bool m_interpolating;
+
+    // render scale and quality tier follow frame times while rendering every vsync
+    qint64 m_renderTime;
+    bool m_continuous;
+    // output has to be drawn even if no input changed, e.g. new buffer or shader
+    bool m_dirty;
+    ResolutionController m_resolution;
+    bool m_scaleChanged;
+    qreal m_publishedFrameTime;
+
+    // read only from the render thread
+    std::shared_ptr<AnalysisFrameBuffer> m_frameBuffer;
     std::shared_ptr<QOpenGLTexture> m_texture;
+    std::shared_ptr<QOpenGLTexture> m_historyTexture;
+    QOpenGLBuffer m_pixelBuffer;
+    // texture contents as last uploaded, to skip unchanged rows
+    std::vector<uint16_t> m_uploadedTexture;
 
-    std::unique_ptr<QOpenGLShaderProgram> m_program;
-    std::unique_ptr<QOpenGLShader> m_shader;
     QQuickWindow *m_window;
+    QOpenGLFramebufferObject* m_output;
+    qint64 m_offlineTime;
+    bool m_initialized;
+
+    // linked programs stay resident, switching shaders or tiers is a pointer swap
+    QHash<QString, std::shared_ptr<QOpenGLShaderProgram>> m_programs;
+    // sources of linked shaders, they decide if tiers share a program
+    QHash<QString, QByteArray> m_sources;
+    ShaderCache* m_shaderCache;
+    int m_warmIndex;
+
+    // graphs of every shader seen so far
+    QHash<QString, RenderGraph> m_graphs;
+    GraphState m_current;
+
+    // previous shader keeps rendering while the current one fades in
+    GraphState m_outgoing;
+    std::shared_ptr<QOpenGLFramebufferObject> m_transitionBuffers[2];
+    std::shared_ptr<QOpenGLShaderProgram> m_blendProgram;
+    qint64 m_transitionStart;
+    qreal m_transitionDuration;
+
+    // beats since the last synchronize, the item rotates shaders on them
+    float m_lastBeatPhase;
+    int m_beats;
 
     QString m_shaderPath;
 };
 
-//TODO: add sound parameters
-class Visualisation : public QQuickItem
+class Visualisation : public QQuickFramebufferObject
 {
     Q_OBJECT
-    Q_PROPERTY(std::shared_ptr<RingBufferT<double>> spectrumBuffer MEMBER m_spectrumBuffer WRITE setSpectrumBuffer)
-    Q_PROPERTY(std::shared_ptr<RingBufferT<double>> waveformBuffer MEMBER m_waveformBuffer WRITE setWaveformBuffer)
-    Q_PROPERTY(QString currentShader MEMBER m_shader)
-
-    std::vector<GLfloat> readFromBufferToGL(std::shared_ptr<RingBufferT<double>>& buffer);
+    Q_PROPERTY(std::shared_ptr<AnalysisFrameBuffer> frameBuffer MEMBER m_frameBuffer WRITE setFrameBuffer)
+    Q_PROPERTY(QString currentShader MEMBER m_shader WRITE setCurrentShader)
+    Q_PROPERTY(ShaderCache* shaderCache MEMBER m_shaderCache WRITE setShaderCache)
+    Q_PROPERTY(qreal renderScale READ renderScale NOTIFY renderStatsChanged)
+    Q_PROPERTY(qreal frameTime READ frameTime NOTIFY renderStatsChanged)
+    Q_PROPERTY(int qualityTier READ qualityTier NOTIFY renderStatsChanged)
+    Q_PROPERTY(bool autoScale MEMBER m_autoScale WRITE setAutoScale)
+    Q_PROPERTY(qreal targetFrameRate MEMBER m_targetFrameRate WRITE setTargetFrameRate)
+    Q_PROPERTY(qreal transitionDuration MEMBER m_transitionDuration WRITE setTransitionDuration)
+    Q_PROPERTY(QStringList shaderPlaylist MEMBER m_shaderPlaylist)
+    Q_PROPERTY(bool rotateOnTrackChange MEMBER m_rotateOnTrackChange)
+    Q_PROPERTY(int rotateEveryBeats MEMBER m_rotateEveryBeats)
+
+    friend class VisualisationRenderer;
 
 public:
     Visualisation();
 
+    Renderer *createRenderer() const override;
+
+protected:
+    void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+
+public:
+    qreal renderScale() const;
+    qreal frameTime() const;
+    int qualityTier() const;
+
 public slots:
-    void sync();
-    void cleanup();
-    void setSpectrumBuffer(const std::shared_ptr<RingBufferT<double>>& buffer);
-    void setWaveformBuffer(const std::shared_ptr<RingBufferT<double>>& buffer);
+    void setFrameBuffer(const std::shared_ptr<AnalysisFrameBuffer>& buffer);
+    void setCurrentShader(const QString& shader);
+    void setShaderCache(ShaderCache* cache);
+    void setAutoScale(bool autoScale);
+    void setTargetFrameRate(qreal fps);
+    void setTransitionDuration(qreal seconds);
+
+    // switch to the next shader of the playlist, all visualisations if it is empty
+    void nextShader();
+    void trackChanged();
 
-    void refresh();
-private slots:
-    void handleWindowChanged(QQuickWindow *win);
+    // new analysis frame is ready, render it on the next vsync
+    void frameReady();
+
+signals:
+    void renderStatsChanged();
 
 private:
-    VisualisationRenderer *m_renderer;
-    std::shared_ptr<RingBufferT<double>> m_spectrumBuffer;
-    std::shared_ptr<RingBufferT<double>> m_waveformBuffer;
+    std::shared_ptr<AnalysisFrameBuffer> m_frameBuffer;
+    ShaderCache* m_shaderCache;
 
     QString m_shader;
-    QTimer m_updateTimer;
+
+    bool m_autoScale;
+    qreal m_targetFrameRate;
+    qreal m_transitionDuration;
+
+    // automatic rotation through the playlist
+    QStringList m_shaderPlaylist;
+    bool m_rotateOnTrackChange;
+    int m_rotateEveryBeats;
+
+    // written by the renderer in synchronize
+    qreal m_renderScale;
+    qreal m_frameTime;
+    int m_qualityTier;
+    int m_beats;
 };
 
 #endif // VISUALISATION_RENDERER_H
@@ -0,0 +1,80 @@
+#include "waveformimageprovider.h"
+
+#include "playbackengine.h"
+
+#include <QPainter>
+#include <QStringList>
+
+#include <algorithm>
+
+constexpr auto default_width = 512;
+constexpr auto default_height = 32;
+
+WaveformImageProvider::WaveformImageProvider(PlaybackEngine* engine)
+    : QQuickImageProvider(QQuickImageProvider::Image,
+                          QQuickImageProvider::ForceAsynchronousImageLoading),
+      m_engine(engine),
+      m_peakColor(255, 255, 255, 96),
+      m_rmsColor(255, 255, 255, 192)
+{
+}
+
+QImage WaveformImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    const int width = requestedSize.width() > 0 ? requestedSize.width() : default_width;
+    const int height = requestedSize.height() > 0 ? requestedSize.height() : default_height;
+
+    if(size) {
+        *size = QSize(width, height);
+    }
+
+    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    auto peaks = m_engine->waveformOverview();
+    if(!peaks || !peaks->frames()) {
+        return image;
+    }
+
+    // optional visible range
+    double from = 0.0, to = 1.0;
+    const QStringList parts = id.split('/');
+    if(parts.size() == 3) {
+        from = qBound(0.0, parts[1].toDouble(), 1.0);
+        to = qBound(from, parts[2].toDouble(), 1.0);
+    }
+
+    // pick a level with about one bucket per pixel, so drawing does not depend on track length
+    const double visibleFrames = (to - from) * peaks->frames();
+    int level = 0;
+    for(int i = audioengine::PeakPyramid::levels - 1; i >= 0; --i) {
+        if(visibleFrames / audioengine::PeakPyramid::bucket_sizes[i] >= width) {
+            level = i;
+            break;
+        }
+    }
+
+    const double bucketSize = audioengine::PeakPyramid::bucket_sizes[level];
+    const double firstBucket = from * peaks->frames() / bucketSize;
+    const double bucketsPerPixel = visibleFrames / bucketSize / width;
+    const float halfHeight = height / 2.f;
+
+    QPainter painter(&image);
+
+    for(int x = 0; x < width; ++x) {
+        const qint64 begin = static_cast<qint64>(firstBucket + x * bucketsPerPixel);
+        const qint64 end = static_cast<qint64>(firstBucket + (x + 1) * bucketsPerPixel);
+
+        const auto bucket = peaks->summarize(level, begin, end);
+
+        painter.setPen(m_peakColor);
+        painter.drawLine(QPointF(x, halfHeight - bucket.max * halfHeight),
+                         QPointF(x, halfHeight - bucket.min * halfHeight));
+
+        painter.setPen(m_rmsColor);
+        painter.drawLine(QPointF(x, halfHeight - bucket.rms * halfHeight),
+                         QPointF(x, halfHeight + bucket.rms * halfHeight));
+    }
+
+    return image;
+}
@@ -0,0 +1,25 @@
+#ifndef WAVEFORMIMAGEPROVIDER_H
+#define WAVEFORMIMAGEPROVIDER_H
+
+#include <QQuickImageProvider>
+#include <QColor>
+
+class PlaybackEngine;
+
+//! Draws the waveform overview of the current file for QML.
+//! Image id is "<revision>" or "<revision>/<from>/<to>",
+//! where 'from' and 'to' select a part of the track in 0 - 1 range.
+class WaveformImageProvider : public QQuickImageProvider
+{
+    PlaybackEngine* m_engine;
+
+    QColor m_peakColor;
+    QColor m_rmsColor;
+
+public:
+    explicit WaveformImageProvider(PlaybackEngine* engine);
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+};
+
+#endif // WAVEFORMIMAGEPROVIDER_H